@@ -26,7 +26,7 @@ from PyQt6 import QtCore, QtGui
 from PyQt6.QtCore import QTimer
 import pyqtgraph as pg
 
-from adc_interfaces import TrigMode
+from adc_interfaces import Decimation, TrigMode, TrigSweep
 from adcs import ADC3908, ADC1175, ADS7884
 from custom_viewbox import CustomViewBox, MinSizeMainWindow, ViewMode
 
@@ -38,9 +38,9 @@ AVAILABLE_BUFFER_SIZES = [512, 1024, 2048, 4096, 8192, 16384, 32767, 65535, 1310
 # Colors for oscilloscope channels (Ch0, Ch1, ...)
 CHANNEL_COLORS = ["#33ee66", "#00aeff", "#ff6633", "#ffdd00", "#cc44ff", "#ff88aa"]
 
-# In LA mode: practical limit based on CB memory (2 CBs * 32 bytes per sample).
-# 65535 samples = ~4 MB of CB memory, which is comfortable on an RPi.
-LA_MAX_SAMPLES = 65535
+# LA captures use a fixed handful of DMA CBs on either backend and 4 bytes
+# per sample per buffer, so LA mode offers deeper buffers.
+LA_BUFFER_SIZES = AVAILABLE_BUFFER_SIZES + [524288, 1048576]
 
 
 def sample_rate_to_msps_str(sample_rate):
@@ -55,7 +55,6 @@ class Oscilloscope(QApplication):
         update_fps: int = 30,
         init_sample_rate: int = int(5e6),
         sample_rates: Sequence[int] = AVAILABLE_SAMPLE_RATES,
-        graph_antialias_factor: int = 8,
     ) -> None:
         super().__init__(argv)
 
@@ -63,7 +62,6 @@ class Oscilloscope(QApplication):
         self.update_fps = update_fps
         self.n_channels = adc.n_channels
         self.sample_rates = sample_rates
-        self.graph_antialias_factor = graph_antialias_factor
         self.la_mode = False
         self.osc_lines : List[pg.PlotDataItem] = []
         self._last_gen = None
@@ -511,21 +509,19 @@ class Oscilloscope(QApplication):
 
         self.sample_buffer_input.blockSignals(True)
         if self.la_mode:
-            # LA mode DMA len is 16-bit; >= 16384 samples * 4 bytes overflows
-            for idx in range(self.sample_buffer_input.count() - 1, -1, -1):
-                if self.sample_buffer_input.itemData(idx) > LA_MAX_SAMPLES:
-                    self.sample_buffer_input.removeItem(idx)
-            # Configure PWM at current sample rate for paced GPIO reads
-            self.adc_sample_rate = self.adc.start_sampling(self.adc_sample_rate)
-        else:
-            for size in AVAILABLE_BUFFER_SIZES:
+            for size in LA_BUFFER_SIZES:
                 if self.sample_buffer_input.findData(size) < 0:
                     self.sample_buffer_input.addItem(str(size), size)
+            # Configure the LA pacing at the current sample rate
+            self.adc_sample_rate = self.adc.start_sampling(self.adc_sample_rate)
+        else:
+            for idx in range(self.sample_buffer_input.count() - 1, -1, -1):
+                if self.sample_buffer_input.itemData(idx) not in AVAILABLE_BUFFER_SIZES:
+                    self.sample_buffer_input.removeItem(idx)
         self.sample_buffer_input.blockSignals(False)
 
-        if self.la_mode and self.adc.n_samples > LA_MAX_SAMPLES:
-            max_allowed = self.sample_buffer_input.itemData(self.sample_buffer_input.count() - 1)
-            self.resize_sample_buffer(max_allowed)
+        if not self.la_mode and self.adc.n_samples > AVAILABLE_BUFFER_SIZES[-1]:
+            self.resize_sample_buffer(AVAILABLE_BUFFER_SIZES[-1])
         else:
             self.resize_sample_buffer(self.adc.n_samples)
             self._recreate_plot_lines()
@@ -553,7 +549,7 @@ class Oscilloscope(QApplication):
         )
         self.trig_line.setVisible(visible)
 
-    def sample_osc(self):
+    def push_trigger_settings(self):
         skip_samples = 0
         if isinstance(self.adc, ADC1175):
             # TODO: Hack. Things get less reliable for early samples at high sample
@@ -573,31 +569,44 @@ class Oscilloscope(QApplication):
             low_thresh = float(self.trig_line.value())
             high_thresh = float(self.trig_line.value())
 
+        # TODO: Allow triggering on user's choice of channel instead of always ch1?
+        low_thresh = self.adc.real_to_adc_fs(low_thresh, 0)
+        high_thresh = self.adc.real_to_adc_fs(high_thresh, 0)
+
+        # A one-shot capture waits for a trigger, so let the worker drop
+        # untriggered frames instead of sending them here.
+        sweep = TrigSweep.NORMAL if self.trig_oneshot_button.isChecked() else TrigSweep.AUTO
+
+        self.adc.set_trigger(
+            self.trig_mode,
+            thresh=(low_thresh, high_thresh),
+            auto_range=self.trig_auto_checkbox.isChecked(),
+            skip_samples=skip_samples,
+            sweep=sweep,
+        )
+
+    def sample_osc(self):
         screen_width = self.graph.width()
         if screen_width <= 0:
             screen_width = 800
 
         x_range = tuple(self.graph.getViewBox().viewRange()[0])
 
-        # TODO: Allow triggering on user's choice of channel instead of always ch1?
-        low_thresh = self.adc.real_to_adc_fs(low_thresh, 0)
-        high_thresh = self.adc.real_to_adc_fs(high_thresh, 0)
-
+        # The trigger was already found by the acquisition worker.
         buffers, triggered, _trig_start = self.adc.get_buffers(
-            screen_width=self.graph_antialias_factor * screen_width,
+            screen_width=screen_width,
             x_range=x_range,
-            auto_range=self.trig_auto_checkbox.isChecked(),
-            thresh=(low_thresh, high_thresh),
-            trig_mode=self.trig_mode,
-            skip_samples=skip_samples,
+            decimation=Decimation.PEAK,
         )
 
-        # shape: [n_ch, screen_width, 2] — last dim is [value, time_seconds]
-        # Timestamps are already trigger-adjusted and in seconds.
+        # shape: [n_ch, 2 * screen_width, 2] — last dim is [value, time_seconds]
+        # Each pixel column gets its min then its max, so glitches narrower
+        # than a pixel still show up. Timestamps are already trigger-adjusted
+        # and in seconds.
         samples, timestamps = buffers[..., 0], buffers[..., 1]
         timestamps = timestamps[0]
 
-        # samples shape: [n_ch, screen_width]
+        # samples shape: [n_ch, 2 * screen_width]
         samples = [
             self.adc.adc_fs_to_real(samples[ch], ch)
             for ch in range(self.n_channels)
@@ -609,6 +618,10 @@ class Oscilloscope(QApplication):
         if self.paused or self.adc.n_active_channels() < 1:
             return
 
+        # Pushed every tick (cheap), so the worker sees changes even while no
+        # new generations arrive (normal sweep with no trigger).
+        self.push_trigger_settings()
+
         current_gen = self.adc.data_generation
         if current_gen == self._last_gen:
             return
@@ -651,6 +664,12 @@ def main():
     else:
         adc = ADC3908()
 
+    # osc.bash keeps cpu 3 free (isolcpus=3) for the sampler thread.
+    try:
+        adc.set_realtime(cpu=3, fifo_priority=80, lock_memory=True)
+    except RuntimeError as e:
+        print(f"Sampling without real-time scheduling: {e}")
+
     print("Setting up app...")
     pg.setConfigOptions(antialias=True)
     app = Oscilloscope(sys.argv, adc, init_sample_rate=init_sample_rate, sample_rates=sample_rates)
@@ -3,16 +3,32 @@
 #include <algorithm>
 #include <cmath>
 #include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <future>
 
+#include <pybind11/stl.h>
+
+#include "capture_recorder.hpp"
 #include "peripherals/dma/dma_defs.hpp"
 #include "peripherals/gpio/gpio_defs.hpp"
 #include "peripherals/pwm/pwm_defs.hpp"
+#include "peripherals/smi/smi_defs.hpp"
+#include "sample_kernels.hpp"
+
+using namespace pybind11::literals;
 
 ADC::ADC(std::pair<float, float> vref, int n_samples, int n_channels) :
     _VREF(vref),
     _n_samples(n_samples),
-    _n_channels(n_channels)
+    _n_channels(n_channels),
+    _dma_chan(DMAChannelRegistry::instance().acquire(_dma))
 {
+    // TripleBuffer slots start value-initialized, i.e. null. Subclass
+    // constructors resize() before any _resize_captures(), and resize()
+    // looks at the write slot, so give every slot an empty capture first.
+    _frames.reset(std::make_shared<Capture>());
+
     _active_channels.resize(n_channels);
     for (int ch = 0; ch < n_channels; ++ch) {
         _active_channels[ch] = false;
@@ -23,17 +39,141 @@ ADC::~ADC() {
     _la_free_buf();
 }
 
-void ADC::_resize_flat_bufs(int n_channels, int n_samples) {
-    _front_bufs = py::array_t<float>({n_channels, n_samples, 2});
-    _back_bufs  = py::array_t<float>({n_channels, n_samples, 2});
-    std::memset(_front_bufs.mutable_data(), 0, _front_bufs.nbytes());
-    std::memset(_back_bufs.mutable_data(),  0, _back_bufs.nbytes());
+void ADC::_resize_captures(int n_channels, int n_samples) {
+    // Fresh captures: readers may still hold the old ones, which stay valid
+    // until they let go.
+    auto front = std::make_shared<Capture>();
+    front->words.assign(n_samples, 0);
+    front->channels.assign(n_channels, ChannelField{});
+    front->gen = _front_gen.load();
+    front->codes = _codes;
+    _pinned_captures.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(_reader_mutex);
+        _frames.reset(front);
+    }
+    _frames.write_slot() = std::make_shared<Capture>(*front);
+    _invalidate_buffers_cache();
+}
+
+std::shared_ptr<const Capture> ADC::_pin_latest() {
+    const auto t_wait = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(_reader_mutex);
+    _reader_lock_wait.record(std::chrono::steady_clock::now() - t_wait);  // recorded under the lock
+    _frames.update();
+    return _frames.read_slot();
+}
+
+void ADC::_recycle_write_slot() {
+    // Readers only take references from the read slot, so once the write
+    // slot's count drops to 1 nobody can take a new reference to it. The
+    // fence orders our writes after the readers' last reads (their release).
+    auto& slot = _frames.write_slot();
+    if (slot.use_count() == 1) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return;
+    }
+
+    for (auto& parked : _pinned_captures) {
+        if (parked.use_count() == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            std::swap(parked, slot);
+            return;
+        }
+    }
+
+    // Every parked capture is pinned: park this one too and start a new
+    // capture of the same shape. Bounded by how many captures readers hold.
+    auto fresh = std::make_shared<Capture>();
+    fresh->words.resize(slot->words.size());
+    fresh->channels.resize(slot->channels.size());
+    _pinned_captures.push_back(std::move(slot));
+    slot = std::move(fresh);
+}
+
+void ADC::_build_pyramid(Capture& cap, int ch) const {
+    cap.pyramids.resize(cap.channels.size());
+
+    const auto& field = cap.channels[ch];
+    if (!field.active) {
+        cap.pyramids[ch].clear();
+        return;
+    }
+    cap.pyramids[ch].build(
+        cap.words.data(), static_cast<int>(cap.words.size()), field.shift, field.mask,
+        cap.codes->volts.data(), cap.codes->version
+    );
+}
+
+void ADC::_decode_channel(const Capture& cap, int ch, int begin, int end, float* dst) const {
+    const auto& field = cap.channels[ch];
+    if (!field.active) {
+        std::fill(dst, dst + (end - begin), 0.0f);
+        return;
+    }
+
+    sample_kernels::decode_field(
+        cap.words.data() + begin, end - begin, field.shift, field.mask, cap.codes->volts.data(), dst
+    );
+}
+
+// ---- Code conversion table ------------------------------------------------
+
+void ADC::_rebuild_code_table() {
+    // Published captures keep the old table; get_buffers() re-bins them
+    // with this one.
+    auto codes = std::make_shared<CodeTable>();
+    codes->vref    = _VREF;
+    codes->version = _codes->version + 1;
+
+    if (_logic_analyzer_mode) {
+        codes->volts = {0.0f, 1.0f};
+    } else {
+        const uint32_t n_codes = 1u << _code_bits();
+        codes->volts.resize(n_codes);
+        for (uint32_t code = 0; code < n_codes; ++code) {
+            codes->volts[code] = _code_to_float(code);
+            if (!_code_calibration.empty()) {
+                codes->volts[code] += _code_calibration[code];
+            }
+        }
+    }
+    _codes = std::move(codes);
+}
+
+void ADC::set_VREF(std::pair<float, float> vref) {
+    const bool was_running = _running.load();
+    if (was_running) _stop_worker();
+
+    _VREF = vref;
+    _rebuild_code_table();
+
+    if (was_running) _start_worker(_get_sample_rate_hz());
+}
+
+void ADC::set_code_calibration(const std::vector<float>& correction) {
+    const size_t n_codes = size_t(1) << _code_bits();
+    if (!correction.empty() && correction.size() != n_codes) {
+        throw std::runtime_error(
+            "Code calibration must have one entry per code (" + std::to_string(n_codes) + ")."
+        );
+    }
+
+    const bool was_running = _running.load();
+    if (was_running) _stop_worker();
+
+    _code_calibration = correction;
+    _rebuild_code_table();
+
+    if (was_running) _start_worker(_get_sample_rate_hz());
 }
 
 // ---- LA buffer management -----------------------------------------------
 
 void ADC::_la_alloc_buf(int n_samples) {
-    const int n_bytes = n_samples * sizeof(uint32_t);
+    // Both buffers, each with LA_PAD_WORDS either side for the PWM pacer.
+    const int n_bytes = (2 * n_samples + 3 * LA_PAD_WORDS) * sizeof(uint32_t);
     if (_dma._use_vc_mem) {
         _la_data = _dma._mbox.alloc_vc_mem(n_bytes, _asi.page_size);
     } else {
@@ -59,73 +199,212 @@ void ADC::_la_free_buf() {
 // ---- LA DMA CB setup -------------------------------------------------------
 
 void ADC::_setup_la_dma_cbs() {
-    _dma.resize_cbs(2 * _n_samples);
+    if (_la_active == LABackend::SMI) {
+        _la_pace_chan.release();
 
-    const auto gpio_lev0_bus_addr = (uint32_t)(uintptr_t)_gpio.reg_to_bus(GPIO_LVL_OFS);
-    const auto pwm_fifo_bus_addr  = (uint32_t)(uintptr_t)_pwm.reg_to_bus(PWM0_FIF_OFS);
+        // The same chunked receive chain as ParallelADC's. SMI packs 8-bit
+        // samples in pairs, the last odd one in the upper byte of a 16-bit
+        // word, so read whole pairs.
+        const uint32_t n_bytes = (_logic_analyzer_n_bits == 8)
+            ? (_n_samples + _n_samples % 2) : 2 * _n_samples;
+        static constexpr uint32_t smi_ti = dma_ti({
+            .dest_addr_incr=true, .src_dma_req=true, .peri_map=DMA_PERI_MAP_SMI
+        });
+        const auto smi_data_bus_addr = (uint32_t)(uintptr_t)_smi.reg_to_bus(SMI_DATA_OFS);
 
-    // Two CBs per sample: cb_pwm waits for PWM DREQ then writes a dummy word to
-    // the PWM FIFO (consuming the token), then cb_gpio immediately reads GPIO.
-    for (int i = 0; i < _n_samples; ++i) {
-        auto& cb_pwm  = _dma.get_cb(2 * i);
-        auto& cb_gpio = _dma.get_cb(2 * i + 1);
+        DMAChain chain(DMA_LITE_MAX_XFER_LEN);
+        for (int b = 0; b < 2; ++b) {
+            const auto rx_bus = (uint32_t)(uintptr_t)(_la_rx_data_bus + _la_buf_ofs(b));
+            _la_first_cb[b] = chain.peri_to_mem(
+                smi_ti, smi_data_bus_addr, rx_bus, n_bytes, SMI_DMA_MAX_CB_BYTES, /*align=*/2
+            );
+            chain.stop(chain.last());
+            if (_dma_irq_fd >= 0) chain.interrupt(chain.last());
+        }
+        _dma.load_chain(chain);
+        return;
+    }
 
-        cb_pwm.ti = DMATransferInfo{{
-            .wait_for_writes=1, .dest_dma_req=1,
-            .src_ignore_reads=1, .peri_map=DMA_PERI_MAP_PWM
-        }}.bits;
-        cb_pwm.src     = 0;
-        cb_pwm.dst     = pwm_fifo_bus_addr;
-        cb_pwm.len     = 4;
-        cb_pwm.next_cb = (uint32_t)(uintptr_t)_dma.get_cb_bus_ptr(2 * i + 1);
+    // Two channels and four CBs, whatever the buffer size. The pacer, on a
+    // full channel for its length, moves one word per PWM DREQ from the
+    // buffer into the PWM FIFO, so its SOURCE_AD register steps through the
+    // buffer once per sample period. On _dma_chan a two-CB loop copies
+    // SOURCE_AD into the read CB's dst, reads GPLEV0 there and goes round
+    // again, so each word ends up holding the last read before the pacer
+    // moved past it: the sample at that tick, give or take one loop.
+    //
+    // The pacer starts LA_PAD_WORDS early, so the FIFO has filled and the
+    // reads are paced by the time it reaches the first sample, and leaves
+    // SOURCE_AD in the pad after the buffer, where the loop writes until
+    // the channels are reset.
+    if (!_la_pace_chan) {
+        _la_pace_chan = DMAChannelRegistry::instance().acquire(_dma, DMAChannelKind::FULL);
+    }
+
+    static constexpr uint32_t pace_ti = dma_ti_mem_to_peri(DMA_PERI_MAP_PWM);
+    static constexpr uint32_t read_ti = dma_ti({.wait_for_writes=true});
+    const auto gpio_lev0_bus_addr = (uint32_t)(uintptr_t)_gpio.reg_to_bus(GPIO_LVL_OFS);
+    const auto pwm_fifo_bus_addr  = (uint32_t)(uintptr_t)_pwm.reg_to_bus(PWM0_FIF_OFS);
+    const auto pace_src_bus_addr  = (uint32_t)(uintptr_t)_dma.reg_to_bus(DMA_SRC_OFS(_la_pace_chan.id()));
 
-        cb_gpio.ti = DMATransferInfo{{.wait_for_writes=1}}.bits;
-        cb_gpio.src    = gpio_lev0_bus_addr;
-        cb_gpio.dst    = (uint32_t)(uintptr_t)(_la_rx_data_bus + i);
-        cb_gpio.len    = 4;
-        cb_gpio.next_cb = (i < _n_samples - 1)
-            ? (uint32_t)(uintptr_t)_dma.get_cb_bus_ptr(2 * i + 2) : 0;
+    DMAChain chain(_la_pace_chan.max_xfer_len());
+    for (int b = 0; b < 2; ++b) {
+        const auto pad_bus = (uint32_t)(uintptr_t)(_la_rx_data_bus + _la_buf_ofs(b) - LA_PAD_WORDS);
+        _la_first_cb[b] = chain.add(
+            pace_ti, pad_bus, pwm_fifo_bus_addr, (LA_PAD_WORDS + _n_samples) * sizeof(uint32_t)
+        );
+        chain.stop(_la_first_cb[b]);
     }
+
+    _la_read_cb = chain.add(read_ti, pace_src_bus_addr, 0, sizeof(uint32_t));
+    const int read = chain.add(read_ti, gpio_lev0_bus_addr, 0, sizeof(uint32_t));
+    chain.dst_to_cb(_la_read_cb, read, offsetof(DMAControlBlock, dst));
+    chain.link(read, _la_read_cb);
+    _dma.load_chain(chain);
 }
 
 // ---- LA sampling / fetch ---------------------------------------------------
 
-void ADC::_la_start_sampling(uint32_t rate_hz) {
-    _pwm.setup_clock(0.5f, (float)rate_hz, ClockSource::PLLD);
-    _pwm.enable_dma();
-    _start_worker(rate_hz);
+void ADC::set_la_backend(LABackend backend) {
+    _la_backend = backend;
+}
+
+uint32_t ADC::_la_setup_sampling(uint32_t rate_hz) {
+    // SMI timing bottoms out around 180 kS/s (63 clocks each of setup, strobe
+    // and hold at the slowest SMI clock); AUTO paces slower rates with PWM.
+    LABackend backend = (_la_backend == LABackend::PWM) ? LABackend::PWM : LABackend::SMI;
+    uint32_t real_rate_hz = rate_hz;
+    if (backend == LABackend::SMI) {
+        try {
+            real_rate_hz = _smi.setup_timing(rate_hz, ClockSource::PLLD);
+        } catch (const std::runtime_error&) {
+            if (_la_backend == LABackend::SMI) throw;
+            backend = LABackend::PWM;
+        }
+    }
+
+    if (backend != _la_active) {
+        _la_active = backend;
+        _setup_la_dma_cbs();
+    }
+
+    // SMI samples the pins as its data lines; the PWM path reads GPLEV0.
+    const GPIOMode mode = (backend == LABackend::SMI) ? GPIOMode::ALT_1 : GPIOMode::IN;
+    for (int pin = 8; pin < 8 + _logic_analyzer_n_bits; ++pin) {
+        _gpio.set_mode(pin, mode);
+    }
+
+    if (backend == LABackend::SMI) {
+        const SMIWidth width = (_logic_analyzer_n_bits == 8) ? SMIWidth::_8_BITS : SMIWidth::_16_BITS;
+        _smi.setup_device_settings(width, /*device_id=*/0, /*use_dma=*/true);
+    } else {
+        real_rate_hz = static_cast<uint32_t>(std::lround(
+            _pwm.setup_clock(0.5f, (float)rate_hz, ClockSource::PLLD)
+        ));
+        _pwm.enable_dma();
+    }
+    return real_rate_hz;
 }
 
 void ADC::_start_la_fetch() {
+    if (_la_active == LABackend::SMI) {
+        _smi.start_xfer(_n_samples, /*packed=*/true);
+        _dma.start(_dma_chan.id(), /*first_cb_idx=*/_la_first_cb[_la_rx_fill]);
+        return;
+    }
+
+    // The read loop can fall behind the pacer at high rates and skip words;
+    // mark them all so _finish_la_fetch() can find the ones it skipped.
+    uint32_t* rx = _la_rx_data_virt + _la_buf_ofs(_la_rx_fill);
+    std::fill_n(rx, _n_samples, LA_UNWRITTEN);
+    if (!_dma._use_vc_mem) clean_cache(rx, rx + _n_samples, _asi.cache_line_size);
+
+    // The pacer first. Its SOURCE_AD still holds wherever the last capture
+    // left it until it has loaded its CB, and the read loop writes wherever
+    // SOURCE_AD points, so don't start the loop until it is in this buffer's
+    // leading pad.
     _pwm.start();
-    _dma.start(_la_dma_chan, /*first_cb_idx=*/0);
+    _dma.start(_la_pace_chan.id(), /*first_cb_idx=*/_la_first_cb[_la_rx_fill]);
+
+    const auto pad_begin = (uint32_t)(uintptr_t)(_la_rx_data_bus + _la_buf_ofs(_la_rx_fill) - LA_PAD_WORDS);
+    const auto pad_end   = pad_begin + LA_PAD_WORDS * sizeof(uint32_t);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    while (true) {
+        const uint32_t src = *_dma._src_regs[_la_pace_chan.id()];
+        if (src >= pad_begin && src < pad_end) break;
+        if (std::chrono::steady_clock::now() > deadline) {
+            // Leave the read loop off; _wait_la_fetch() sees the pacer
+            // time out (or fail) and drops the capture.
+            return;
+        }
+    }
+    _dma.start(_dma_chan.id(), /*first_cb_idx=*/_la_read_cb);
 }
 
-void ADC::_finish_la_fetch(float* target) {
-    const int rate_hz = static_cast<int>(_get_sample_rate_hz());
-    // Break up the wait into chunks to balance sleeping vs. finishing on time.
-    _dma.wait(
-        _la_dma_chan,
-        16,
-        std::max(1000000 * _n_samples / (8 * rate_hz), 1)
+bool ADC::_wait_la_fetch() {
+    // The PWM path is done when the pacer is; its read loop never ends, and
+    // the pacer's channel isn't the one a UIO fd is bound to.
+    const bool smi = (_la_active == LABackend::SMI);
+    const int n_ticks = _n_samples + (smi ? 0 : LA_PAD_WORDS);
+    const auto status = _wait_dma(
+        smi ? _dma_chan.id() : _la_pace_chan.id(), _fetch_started,
+        static_cast<double>(n_ticks) / _get_sample_rate_hz(), /*use_irq=*/smi
     );
 
-    _dma.reset(_la_dma_chan);
-    _pwm.stop();
+    _dma.reset(_dma_chan.id());
+    if (smi) {
+        _smi.stop_xfer();
+    } else {
+        _dma.reset(_la_pace_chan.id());
+        _pwm.stop();
+    }
+    if (!status.ok()) return false;
 
-    for (int bit = 0; bit < _logic_analyzer_n_bits; ++bit) {
+    _la_rx_ready = _la_rx_fill;
+    _la_rx_fill ^= 1;
+    return true;
+}
+
+void ADC::_finish_la_fetch(Capture& target) {
+    // LA channel b is GPIO 8 + b, in bit b of each word.
+    uint32_t* rx = _la_rx_data_virt + _la_buf_ofs(_la_rx_ready);
+    if (_la_active == LABackend::PWM) {
+        // Words the read loop was too slow to write hold the same level as
+        // the last one it did (or, at the start, the first). A GPIO word that
+        // happens to equal LA_UNWRITTEN gets the same treatment, which at
+        // worst repeats one sample.
+        if (!_dma._use_vc_mem) clean_cache(rx, rx + _n_samples, _asi.cache_line_size);
+        const uint32_t* first = std::find_if(rx, rx + _n_samples, [](uint32_t w) { return w != LA_UNWRITTEN; });
+        uint64_t n_missed = 0;
+        uint32_t last = (first != rx + _n_samples) ? *first : 0;
         for (int i = 0; i < _n_samples; ++i) {
-            const uint32_t gpio_word = _la_rx_data_virt[i];
-            target[bit * _n_samples * 2 + i * 2 + 0] =
-                ((gpio_word >> (8 + bit)) & 1) ? 1.0f : 0.0f;
-            target[bit * _n_samples * 2 + i * 2 + 1] = static_cast<float>(i);
+            if (rx[i] == LA_UNWRITTEN) {
+                rx[i] = last;
+                ++n_missed;
+            } else {
+                last = rx[i];
+            }
         }
+        _acq_la_missed += n_missed;
+
+        sample_kernels::extract_gpio_field(
+            rx, _n_samples, 8, (1u << _logic_analyzer_n_bits) - 1, target.words.data()
+        );
+    } else if (_logic_analyzer_n_bits == 8) {
+        // Packed and pair-swapped, as in ParallelADC's single-channel mode.
+        sample_kernels::unpack_packed_u8((const uint16_t*)rx, _n_samples, target.words.data());
+    } else {
+        sample_kernels::copy_words((const uint16_t*)rx, _n_samples, target.words.data());
+    }
+    for (int bit = 0; bit < _logic_analyzer_n_bits; ++bit) {
+        target.channels[bit] = {.active=true, .shift=bit, .mask=1};
     }
 }
 
 void ADC::_abort_la_fetch() {
-    _pwm.stop();
-    _dma.reset(_la_dma_chan);
+    if (_la_active == LABackend::SMI) _smi.stop_xfer(); else _pwm.stop();
+    _dma.reset(_dma_chan.id());
+    if (_la_pace_chan) _dma.reset(_la_pace_chan.id());
 }
 
 // ---- LA resize helper ------------------------------------------------------
@@ -133,7 +412,7 @@ void ADC::_abort_la_fetch() {
 void ADC::_la_resize(int n_samples) {
     _la_free_buf();
     _la_alloc_buf(n_samples);
-    _resize_flat_bufs(_logic_analyzer_n_bits, n_samples);
+    _resize_captures(_logic_analyzer_n_bits, n_samples);
     _setup_la_dma_cbs();
 }
 
@@ -143,11 +422,13 @@ void ADC::set_logic_analyzer_mode(bool enable, int n_bits) {
     if (enable && n_bits != 8 && n_bits != 16)
         throw std::runtime_error("n_bits must be 8 or 16");
 
+    const ScopedTiming timing(_reconfig_time);
     _stop_worker();
     _la_free_buf();
 
     _logic_analyzer_mode = enable;
     _logic_analyzer_n_bits = n_bits;
+    _rebuild_code_table();
 
     if (enable) {
         _gpio.push_regs();
@@ -169,11 +450,15 @@ void ADC::set_logic_analyzer_mode(bool enable, int n_bits) {
         _gpio.set_mode(22, GPIOMode::IN);
         _gpio.set_mode(23, GPIOMode::IN);
 
+        // AUTO keeps whichever backend the last LA start_sampling() chose.
+        if (_la_backend != LABackend::AUTO) _la_active = _la_backend;
+
         _la_alloc_buf(_n_samples);
-        _resize_flat_bufs(n_bits, _n_samples);
+        _resize_captures(n_bits, _n_samples);
         _setup_la_dma_cbs();
     } else {
         _gpio.pop_regs();
+        _la_pace_chan.release();
         _on_la_mode_exit();
     }
 }
@@ -184,6 +469,12 @@ void ADC::_start_worker(double rate_hz) {
     _stop_worker();  // join any existing worker before starting a new one
     _running = true;
     _worker_thread = std::thread(&ADC::_worker_loop, this, rate_hz);
+
+    // set_realtime() already had these accepted, so a refusal here means
+    // something changed underneath; realtime_status() shows what stuck.
+    try {
+        apply_realtime(_worker_thread.native_handle(), _rt_settings);
+    } catch (const std::runtime_error&) {}
 }
 
 void ADC::_stop_worker() {
@@ -193,15 +484,230 @@ void ADC::_stop_worker() {
     }
 }
 
+double ADC::_fetch_lead_time_s(double, double) const {
+    return 0.0;
+}
+
+DMAWaitStatus ADC::_wait_dma(
+    int channel, std::chrono::steady_clock::time_point started, double nominal_s, bool use_irq
+) {
+    DMAWaitPolicy policy;
+    policy.expected_s = nominal_s * _xfer_time_ratio;
+    policy.timeout_s  = nominal_s + 0.1;
+    // Wake early by about the worst lateness seen so far.
+    policy.sleep_margin_s = std::clamp(1e-9 * _wake_lateness.quantile_ns(0.99), 50e-6, 2e-3);
+    policy.irq_fd = use_irq ? _dma_irq_fd : -1;
+
+    const auto t_wait = std::chrono::steady_clock::now();
+    const DMAWaitStatus status = _dma.wait_done(channel, started, policy, &_running, &_wake_lateness);
+    _dma_wait_time.record(std::chrono::steady_clock::now() - t_wait);
+
+    switch (status.result) {
+        case DMAWaitResult::DONE:
+            // Only a completion seen while polling tells the real duration.
+            // Already done at the first look means the estimate is late by
+            // an unknown amount, so pull it in a little.
+            if (status.saw_completion && nominal_s > 0.0) {
+                _xfer_time_ratio += 0.125 * (status.elapsed_s / nominal_s - _xfer_time_ratio);
+            } else {
+                _xfer_time_ratio *= 0.99;
+            }
+            _xfer_time_ratio = std::clamp(_xfer_time_ratio, 0.5, 2.0);
+            break;
+        case DMAWaitResult::TIMEOUT: ++_acq_dma_timeouts; break;
+        case DMAWaitResult::ERROR:   ++_acq_dma_errors;   break;
+        case DMAWaitResult::ABORTED: break;
+    }
+    return status;
+}
+
+std::vector<uint64_t> ADC::wake_lateness_histogram() const {
+    std::vector<uint64_t> counts(Log2Histogram::N_BUCKETS);
+    for (int b = 0; b < Log2Histogram::N_BUCKETS; ++b) {
+        counts[b] = _wake_lateness.count(b);
+    }
+    return counts;
+}
+
+std::tuple<py::array_t<float>, py::array_t<uint64_t>> ADC::capture_segments(
+    int n_segments, int segment_samples, float pre_fraction, double timeout_s
+) {
+    if (n_segments < 1 || segment_samples < 1) {
+        throw std::runtime_error("n_segments and segment_samples must be positive.");
+    }
+    if (pre_fraction < 0.0f || pre_fraction > 1.0f) {
+        throw std::runtime_error("pre_fraction must be between 0 and 1.");
+    }
+
+    const bool was_running = _running.load();
+    if (was_running) _stop_worker();
+
+    std::vector<uint16_t> words(size_t(n_segments) * segment_samples);
+    std::vector<uint64_t> stamps(n_segments);
+    std::vector<ChannelField> channels;
+    int n_captured = 0;
+    try {
+        py::gil_scoped_release release;
+        n_captured = _capture_segments(
+            n_segments, segment_samples, pre_fraction, timeout_s,
+            words.data(), stamps.data(), channels
+        );
+    } catch (...) {
+        if (was_running) _start_worker(_get_sample_rate_hz());
+        throw;
+    }
+    if (was_running) _start_worker(_get_sample_rate_hz());
+
+    int n_active = 0;
+    for (const auto& field : channels) n_active += int(field.active);
+
+    py::array_t<float> records({n_captured, n_active, segment_samples});
+    float* dst = records.mutable_data();
+    for (int r = 0; r < n_captured; ++r) {
+        const uint16_t* src = words.data() + size_t(r) * segment_samples;
+        for (const auto& field : channels) {
+            if (!field.active) continue;
+            sample_kernels::decode_field(
+                src, segment_samples, field.shift, field.mask, _codes->volts.data(), dst
+            );
+            dst += segment_samples;
+        }
+    }
+
+    return {records, py::array_t<uint64_t>({n_captured}, stamps.data())};
+}
+
+int ADC::_capture_segments(int, int, float, double, uint16_t*, uint64_t*, std::vector<ChannelField>&) {
+    throw std::runtime_error("Segmented capture is not supported by this ADC.");
+}
+
+void ADC::start_recording(const std::string& path, uint64_t max_bytes, int queue_frames) {
+    if (_recorder) {
+        throw std::runtime_error("Already recording; call stop_recording() first.");
+    }
+
+    RecordingHeader header{};
+    header.sample_rate_hz = _get_sample_rate_hz();
+    header.vref_low       = _VREF.first;
+    header.vref_high      = _VREF.second;
+    header.bit_format     = bit_format();
+    header.code_bits      = _code_bits();
+    header.frame_samples  = _n_samples;
+    header.start_unix_s   = std::chrono::duration<double>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    header.start_steady_s = std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+    header.n_codes = std::min<int>(_codes->volts.size(), RECORDING_MAX_CODES);
+    std::copy_n(_codes->volts.begin(), header.n_codes, header.code_table);
+
+    auto recorder = std::make_unique<CaptureRecorder>(path, header, max_bytes, queue_frames);
+
+    const bool was_running = _running.load();
+    if (was_running) _stop_worker();
+
+    {
+        std::lock_guard<std::mutex> lock(_recorder_mutex);
+        _recorder = std::move(recorder);
+    }
+
+    if (was_running) _start_worker(_get_sample_rate_hz());
+}
+
+RecordingStats ADC::stop_recording() {
+    if (!_recorder) {
+        throw std::runtime_error("Not recording.");
+    }
+
+    const bool was_running = _running.load();
+    if (was_running) _stop_worker();
+
+    std::unique_ptr<CaptureRecorder> recorder;
+    {
+        std::lock_guard<std::mutex> lock(_recorder_mutex);
+        recorder = std::move(_recorder);
+    }
+
+    if (was_running) _start_worker(_get_sample_rate_hz());
+
+    // Draining the queue can take a while on a slow card.
+    py::gil_scoped_release release;
+    recorder->close();
+    return recorder->stats();
+}
+
+RecordingStats ADC::recording_stats() const {
+    std::lock_guard<std::mutex> lock(_recorder_mutex);
+    return _recorder ? _recorder->stats() : RecordingStats{};
+}
+
+void ADC::set_realtime(int cpu, int fifo_priority, bool lock_memory) {
+    const RealtimeSettings settings{.cpu=cpu, .fifo_priority=fifo_priority, .lock_memory=lock_memory};
+
+    if (_running.load() && _worker_thread.joinable()) {
+        apply_realtime(_worker_thread.native_handle(), settings, _rt_settings);
+    } else {
+        // Try them on a parked stand-in so a refusal surfaces now rather
+        // than being swallowed when sampling starts.
+        std::promise<void> release;
+        std::thread stand_in([parked = release.get_future()] { parked.wait(); });
+        try {
+            apply_realtime(stand_in.native_handle(), settings);
+        } catch (const std::runtime_error&) {
+            release.set_value();
+            stand_in.join();
+            throw;
+        }
+        release.set_value();
+        stand_in.join();
+    }
+    _rt_settings = settings;
+}
+
+RealtimeStatus ADC::realtime_status() {
+    if (_running.load() && _worker_thread.joinable()) {
+        return ::realtime_status(_worker_thread.native_handle());
+    }
+
+    // No worker: only the process-wide parts mean anything.
+    RealtimeStatus status = ::realtime_status(pthread_self());
+    status.cpus.clear();
+    status.fifo = false;
+    status.priority = 0;
+    return status;
+}
+
+void ADC::set_dma_irq_fd(int fd) {
+    const bool was_running = _running.load();
+    if (was_running) _stop_worker();
+
+    // The chains' last CBs raise the interrupt only while an fd is set. The
+    // PWM-paced LA path always polls: its pacer runs on another channel.
+    _dma_irq_fd = fd;
+    if (_logic_analyzer_mode) {
+        _setup_la_dma_cbs();
+    } else {
+        _setup_dma_cbs();
+    }
+
+    if (was_running) _start_worker(_get_sample_rate_hz());
+}
+
 void ADC::_worker_loop(double rate_hz) {
+    using clock = std::chrono::steady_clock;
+
+    _fetch_started = clock::now();
+    double prev_end_s = -1.0;
     _start_fetch();
 
     while (_running) {
-        // Sleep for most of the expected transfer duration so _dma.wait() finds
-        // the transfer already complete rather than busy-waiting the whole time.
-        const double expected_s = static_cast<double>(_n_samples) / rate_hz;
-        const double chunk_s    = 0.005;  // check _running every 5 ms
-        double remaining_s = expected_s * 0.9;
+        const auto iter_start = clock::now();
+
+        const double chunk_s = 0.005;  // check _running every 5 ms
+        double remaining_s = _fetch_lead_time_s(
+            rate_hz, std::chrono::duration<double>(iter_start - _fetch_started).count()
+        );
         while (_running && remaining_s > 0.0) {
             const double sleep_s = std::min(chunk_s, remaining_s);
             std::this_thread::sleep_for(std::chrono::duration<double>(sleep_s));
@@ -210,15 +716,74 @@ void ADC::_worker_loop(double rate_hz) {
 
         if (!_running) break;  // abort before collecting; DMA cleaned up below
 
-        _finish_fetch(_back_bufs.mutable_data());
+        const bool fetched = _wait_fetch();
+        if (!_running) break;  // stopped while waiting
+
+        // Queue the next transfer into the other receive buffer before
+        // converting this one, so the hardware keeps sampling meanwhile.
+        const auto ready_start = _fetch_started;
+        _fetch_started = clock::now();
+        _start_fetch();
+
+        if (!fetched) continue;  // timed out or failed; counted in _wait_dma()
+        const auto t_waited = clock::now();
+
+        _recycle_write_slot();
+        Capture& cap = *_frames.write_slot();
+
+        // Backends that know better (continuous mode) overwrite t0.
+        cap.t0 = std::chrono::duration<double>(ready_start.time_since_epoch()).count();
+        cap.dt = 1.0 / rate_hz;
+        cap.codes = _codes;  // only replaced with the worker stopped
+        _finish_fetch(cap);
+        const auto t_converted = clock::now();
 
-        {
-            std::lock_guard<std::mutex> lock(_buf_mutex);
-            std::swap(_front_bufs, _back_bufs);
+        _record_frame_timing(cap, prev_end_s);
+        prev_end_s = cap.t0 + static_cast<double>(cap.words.size()) * cap.dt;
+
+        // Every capture is recorded, including ones NORMAL sweep drops below.
+        if (_recorder) _recorder->push(cap);
+
+        const TriggerSettings trig = trigger_settings();
+
+        // Channel 0's pyramid goes first: the auto-range trigger needs it.
+        _build_pyramid(cap, 0);
+        if (!_fetch_sets_trigger()) _find_trigger(cap, trig);
+
+        // In normal sweep an untriggered capture is dropped here, so readers
+        // never see a new generation for it. The write slot is reused as is.
+        const bool publish = !(
+            trig.sweep == TrigSweep::NORMAL && trig.mode != TrigMode::NONE && !cap.triggered
+        );
+        if (publish) {
+            for (int ch = 1; ch < static_cast<int>(cap.channels.size()); ++ch) {
+                _build_pyramid(cap, ch);
+            }
+        } else {
+            ++_frames_discarded;
+        }
+        const auto t_analyzed = clock::now();
+
+        if (publish) {
+            // Never blocks: readers pick it up on their next get_buffers().
+            cap.gen = _front_gen.load() + 1;
+            if (_frames.publish()) ++_acq_unread;
+            _front_gen.store(cap.gen);
         }
-        ++_front_gen;
+        const auto t_published = clock::now();
 
-        _start_fetch();  // immediately queue next transfer
+        if (publish && cap.triggered && cap.trig_start) {
+            const double trig_s = cap.t0 + *cap.trig_start * cap.dt;
+            _trigger_latency.record(t_published - clock::time_point(
+                std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(trig_s))
+            ));
+        }
+
+        _stage_times[int(WorkerStage::WAIT)].record(t_waited - iter_start);
+        _stage_times[int(WorkerStage::CONVERT)].record(t_converted - t_waited);
+        _stage_times[int(WorkerStage::ANALYZE)].record(t_analyzed - t_converted);
+        _stage_times[int(WorkerStage::PUBLISH)].record(t_published - t_analyzed);
+        _stage_times[int(WorkerStage::PERIOD)].record(t_published - iter_start);
     }
 
     _abort_fetch();  // stop any DMA that was started but not yet collected
@@ -227,83 +792,222 @@ void ADC::_worker_loop(double rate_hz) {
 std::tuple<py::array_t<float>, bool, std::optional<int>> ADC::get_buffers(
     int screen_width,
     std::pair<double, double> x_range,
-    bool auto_range,
-    std::pair<float, float> thresh,
-    TrigMode trig_mode,
-    int skip_samples
+    Decimation decimation
 ) {
-    const auto [x_start, x_end]     = x_range;
-    const auto [low_thresh, high_thresh] = thresh;
-    if (skip_samples < 0) skip_samples = 0;
-
-    // Snapshot the latest completed buffer. Hold the lock only for the copy so
-    // the worker can swap its next completed buffer while we process this one.
-    int n_ch_in_buf = 0;
-    py::array_t<float> snap;
-
-    // Read _front_bufs shape and snapshot its data under one lock. The worker
-    // does std::swap(_front_bufs, _back_bufs) under this same lock, and move-
-    // swap briefly sets _front_bufs.m_ptr = nullptr as an intermediate step —
-    // accessing it outside the lock can dereference null.
-    {
-        std::lock_guard<std::mutex> lock(_buf_mutex);
-        if (_front_bufs.ndim() == 3) {
-            n_ch_in_buf = static_cast<int>(_front_bufs.shape(0));
-        }
+    // Pin the latest published capture. The worker never waits on this.
+    const std::shared_ptr<const Capture> snap = _pin_latest();
+
+    // Bin in the current code table, whichever one the capture was analyzed
+    // with.
+    const std::shared_ptr<const CodeTable> codes = _codes;
+
+    const BuffersKey key{
+        .gen           = snap->gen,
+        .screen_width  = screen_width,
+        .x_range       = x_range,
+        .decimation    = decimation,
+        .table_version = codes->version,
+    };
 
-        if (n_ch_in_buf > 0) {
-            snap = py::array_t<float>({n_ch_in_buf, _n_samples, 2}, _front_bufs.data());
+    // The trigger result belongs to the capture, not to this call.
+    const std::tuple<bool, std::optional<int>> trig = {snap->triggered, snap->trig_start};
+
+    std::lock_guard<std::mutex> cache_lock(_cache_mutex);
+
+    // Time between calls is mostly the caller's (Python's) own work.
+    const auto t_call = std::chrono::steady_clock::now();
+    if (_last_get_buffers.time_since_epoch().count() != 0) {
+        _reader_period.record(t_call - _last_get_buffers);
+    }
+    _last_get_buffers = t_call;
+
+    BuffersCacheEntry* victim = &_buffers_cache[0];
+    for (auto& entry : _buffers_cache) {
+        if (entry.last_used != 0 && entry.key == key) {
+            ++_buffers_cache_hits;
+            entry.last_used = ++_buffers_cache_clock;
+            return std::tuple_cat(std::make_tuple(entry.bufs), trig);
+        }
+        if (entry.last_used < victim->last_used) {
+            victim = &entry;
         }
     }
+    ++_buffers_cache_misses;
+
+    // PEAK emits a (min, max) pair of points per bin.
+    const int n_ch_in_buf = static_cast<int>(snap->channels.size());
+    const int n_points    = ((decimation == Decimation::PEAK) ? 2 : 1) * screen_width;
 
-    if (skip_samples >= _n_samples || n_ch_in_buf == 0 || n_active_channels() == 0) {
-        return {py::array_t<float>({n_ch_in_buf, screen_width, 2}), false, std::nullopt};
+    // Reuse the evicted entry's array if nobody outside the cache holds it.
+    auto& out = victim->bufs;
+    const bool reusable = (
+        out.ndim() == 3 && out.shape(0) == n_ch_in_buf && out.shape(1) == n_points
+        && out.ref_count() == 1
+    );
+    if (!reusable) {
+        out = py::array_t<float>({n_ch_in_buf, n_points, 2});
+    } else {
+        out.attr("setflags")(py::arg("write") = true);
     }
 
-    auto snap_ref = snap.unchecked<3>();
+    _bin_capture(*snap, *codes, _pyramids_for(*snap, *codes), key, out);
+    // Cache hits hand out this same array, so a caller writing into it
+    // would change what later calls get.
+    out.attr("setflags")(py::arg("write") = false);
+    _bin_time.record(std::chrono::steady_clock::now() - t_call);
+    victim->key       = key;
+    victim->last_used = ++_buffers_cache_clock;
+
+    return std::tuple_cat(std::make_tuple(out), trig);
+}
+
+std::tuple<py::array_t<uint16_t>, py::dict> ADC::raw_capture() {
+    const std::shared_ptr<const Capture> snap = _pin_latest();
+    if (!snap || snap->gen == 0) {
+        throw std::runtime_error("No capture has been published yet.");
+    }
+
+    // The capsule owns a reference to the capture, so numpy keeps it pinned
+    // until the array and every view of it are gone.
+    auto* pin = new std::shared_ptr<const Capture>(snap);
+    py::capsule owner(pin, [](void* p) { delete static_cast<std::shared_ptr<const Capture>*>(p); });
+    py::array_t<uint16_t> words({static_cast<py::ssize_t>(snap->words.size())}, snap->words.data(), owner);
+    words.attr("setflags")(py::arg("write") = false);
+
+    py::list channels;
+    for (const auto& field : snap->channels) {
+        channels.append(py::dict("active"_a=field.active, "shift"_a=field.shift, "mask"_a=field.mask));
+    }
+
+    py::dict meta(
+        "gen"_a=snap->gen,
+        "t0"_a=snap->t0,
+        "dt"_a=snap->dt,
+        "channels"_a=channels,
+        "code_table"_a=snap->codes->volts,
+        "VREF"_a=snap->codes->vref,
+        "bit_format"_a=bit_format(),
+        "logic_analyzer_mode"_a=_logic_analyzer_mode,
+        "skip_samples"_a=snap->skip_samples,
+        "triggered"_a=snap->triggered,
+        "trig_start"_a=snap->trig_start
+    );
+    return {words, meta};
+}
+
+void ADC::set_trigger(
+    TrigMode mode,
+    std::pair<float, float> thresh,
+    bool auto_range,
+    int skip_samples,
+    TrigSweep sweep
+) {
+    std::lock_guard<std::mutex> lock(_trig_mutex);
+    _trig_settings = {
+        .mode         = mode,
+        .thresh       = thresh,
+        .auto_range   = auto_range,
+        .skip_samples = std::max(skip_samples, 0),
+        .sweep        = sweep,
+    };
+}
+
+TriggerSettings ADC::trigger_settings() const {
+    std::lock_guard<std::mutex> lock(_trig_mutex);
+    return _trig_settings;
+}
+
+void ADC::_find_trigger(Capture& cap, const TriggerSettings& trig) const {
+    const int n_samples = static_cast<int>(cap.words.size());
+    const int skip_samples = trig.skip_samples;
+
+    cap.skip_samples = skip_samples;
+    cap.triggered    = false;
+    cap.trig_start   = std::nullopt;
 
     // Trigger detection (channel 0 only)
-    bool triggered = false;
-    std::optional<int> trig_start = std::nullopt;
-
-    if (trig_mode != TrigMode::NONE) {
-        const int ch = 0;
-        float low  = low_thresh;
-        float high = high_thresh;
-
-        if (auto_range) {
-            float min_val  = snap_ref(ch, skip_samples, 0);
-            float max_val  = min_val;
-            float mean_val = 0;
-            for (int i = skip_samples + 1; i < _n_samples; ++i) {
-                const float v = snap_ref(ch, i, 0);
-                min_val   = std::min(min_val, v);
-                max_val   = std::max(max_val, v);
-                mean_val += v;
-            }
-            mean_val /= (_n_samples - skip_samples);
-            const float range = max_val - min_val;
-            low  = mean_val - 0.2f * range;
-            high = mean_val + 0.2f * range;
+    if (trig.mode == TrigMode::NONE || skip_samples >= n_samples || cap.channels.empty()) return;
+
+    auto [low, high] = trig.thresh;
+
+    if (trig.auto_range && cap.channels[0].active) {
+        const auto stats = cap.pyramids[0].query(
+            cap.words.data(), cap.codes->volts.data(), skip_samples, n_samples
+        );
+        const float mean_val = static_cast<float>(stats.sum / stats.count);
+        const float range = stats.max - stats.min;
+        low  = mean_val - 0.2f * range;
+        high = mean_val + 0.2f * range;
+    }
+
+    // Decode channel 0 a chunk at a time and stop at the trigger point.
+    const bool rising = (trig.mode == TrigMode::RISING_EDGE);
+    constexpr int chunk_size = 1024;
+    float vals[chunk_size];
+    int armed_at = -1;
+    for (int start = skip_samples; start < n_samples; start += chunk_size) {
+        const int n = std::min(chunk_size, n_samples - start);
+        _decode_channel(cap, 0, start, start + n, vals);
+
+        if (sample_kernels::find_edge(vals, n, low, high, rising, start, &armed_at) >= 0) {
+            cap.triggered = true;
+            break;
         }
+    }
+    if (armed_at >= 0) cap.trig_start = armed_at;
+}
 
-        if (trig_mode == TrigMode::RISING_EDGE) {
-            for (int i = skip_samples; i < _n_samples; ++i) {
-                const float v = snap_ref(ch, i, 0);
-                if (v < low) trig_start = i;
-                if (v >= high && trig_start.has_value()) { triggered = true; break; }
-            }
-        } else if (trig_mode == TrigMode::FALLING_EDGE) {
-            for (int i = skip_samples; i < _n_samples; ++i) {
-                const float v = snap_ref(ch, i, 0);
-                if (v > high) trig_start = i;
-                if (v <= low && trig_start.has_value()) { triggered = true; break; }
+const std::vector<MinMaxPyramid>& ADC::_pyramids_for(const Capture& cap, const CodeTable& codes) {
+    bool current = true;
+    for (size_t ch = 0; ch < cap.pyramids.size(); ++ch) {
+        if (cap.channels[ch].active && cap.pyramids[ch].table_version() != codes.version) {
+            current = false;
+        }
+    }
+    if (current) return cap.pyramids;
+
+    // VREF or the calibration changed since cap was analyzed. Rebuild once
+    // per capture and table so the nodes agree with the edges query() scans.
+    if (_rebuilt_gen != cap.gen || _rebuilt_table_version != codes.version) {
+        _rebuilt_pyramids.resize(cap.channels.size());
+        for (size_t ch = 0; ch < cap.channels.size(); ++ch) {
+            const auto& field = cap.channels[ch];
+            if (!field.active) {
+                _rebuilt_pyramids[ch].clear();
+                continue;
             }
+            _rebuilt_pyramids[ch].build(
+                cap.words.data(), static_cast<int>(cap.words.size()), field.shift, field.mask,
+                codes.volts.data(), codes.version
+            );
         }
+        _rebuilt_gen = cap.gen;
+        _rebuilt_table_version = codes.version;
+    }
+    return _rebuilt_pyramids;
+}
+
+void ADC::_bin_capture(
+    const Capture& snap, const CodeTable& codes, const std::vector<MinMaxPyramid>& pyramids,
+    const BuffersKey& key, py::array_t<float>& out
+) const {
+    const auto [x_start, x_end] = key.x_range;
+    const int screen_width = key.screen_width;
+    const int skip_samples = snap.skip_samples;
+    const bool triggered = snap.triggered;
+    const std::optional<int> trig_start = snap.trig_start;
+
+    const int n_ch_in_buf = static_cast<int>(snap.channels.size());
+    const int n_samples   = static_cast<int>(snap.words.size());
+
+    // dt stays 0 until the worker publishes its first capture.
+    if (skip_samples >= n_samples || n_ch_in_buf == 0 || n_active_channels() == 0 || snap.dt <= 0.0) {
+        std::memset(out.mutable_data(), 0, out.nbytes());
+        return;
     }
 
     // Time origin: sample index at t=0 (trigger point if triggered, else 0)
-    const double sample_rate = _get_sample_rate_hz();
+    const double sample_rate = 1.0 / snap.dt;
     const double trigger_origin = (triggered && trig_start.has_value())
         ? static_cast<double>(*trig_start)
         : 0.0;
@@ -313,48 +1017,207 @@ std::tuple<py::array_t<float>, bool, std::optional<int>> ADC::get_buffers(
     int win_start, win_end;
     if (x_end <= x_start) {
         win_start = skip_samples;
-        win_end   = _n_samples;
+        win_end   = n_samples;
     } else {
         win_start = static_cast<int>(std::round(x_start * sample_rate + trigger_origin));
         win_end   = static_cast<int>(std::round(x_end   * sample_rate + trigger_origin));
         win_start = std::max(win_start, skip_samples);
-        win_end   = std::min(win_end, _n_samples);
+        win_end   = std::min(win_end, n_samples);
     }
 
     if (win_start >= win_end) {
-        return {py::array_t<float>({n_ch_in_buf, screen_width, 2}), triggered, trig_start};
+        std::memset(out.mutable_data(), 0, out.nbytes());
+        return;
     }
 
     // Bin win_start..win_end into screen_width bins. Timestamps are in seconds,
     // relative to the trigger point (or to sample 0 if not triggered).
-    py::array_t<float> binned_bufs({n_ch_in_buf, screen_width, 2});
-    auto bbuf = binned_bufs.mutable_unchecked<3>();
+    auto bbuf = out.mutable_unchecked<3>();
 
     const int win_size = win_end - win_start;
     const float bins_to_samples = static_cast<float>(win_size) / screen_width;
 
-    for (int b = 0; b < screen_width; ++b) {
-        int s_start = win_start + static_cast<int>(b * bins_to_samples);
-        int s_end   = win_start + static_cast<int>((b + 1) * bins_to_samples);
-        if (s_end > win_end) s_end = win_end;
-        if (s_start >= s_end) s_start = std::max(win_start, s_end - 1);
+    for (int ch = 0; ch < n_ch_in_buf; ++ch) {
+        const bool active = snap.channels[ch].active;
 
-        const int count = s_end - s_start;
-        const float bin_time = static_cast<float>(
-            (static_cast<double>(s_start + s_end) * 0.5 - trigger_origin) / sample_rate
-        );
+        for (int b = 0; b < screen_width; ++b) {
+            int s_start = win_start + static_cast<int>(b * bins_to_samples);
+            int s_end   = win_start + static_cast<int>((b + 1) * bins_to_samples);
+            if (s_end > win_end) s_end = win_end;
+            if (s_start >= s_end) {
+                // Fewer samples than bins: every bin still gets one sample,
+                // never an empty range.
+                s_start = std::clamp(s_end - 1, win_start, win_end - 1);
+                s_end   = s_start + 1;
+            }
+
+            const float bin_time = static_cast<float>(
+                (static_cast<double>(s_start + s_end) * 0.5 - trigger_origin) * snap.dt
+            );
+
+            MinMaxPyramid::Stats stats;
+            if (active) {
+                stats = pyramids[ch].query(snap.words.data(), codes.volts.data(), s_start, s_end);
+            } else {
+                stats.count = s_end - s_start;
+            }
 
-        for (int ch = 0; ch < n_ch_in_buf; ++ch) {
-            float sum_val = 0;
-            for (int i = s_start; i < s_end; ++i) {
-                sum_val += snap_ref(ch, i, 0);
+            if (key.decimation == Decimation::PEAK) {
+                bbuf(ch, 2 * b + 0, 0) = stats.min;
+                bbuf(ch, 2 * b + 0, 1) = bin_time;
+                bbuf(ch, 2 * b + 1, 0) = stats.max;
+                bbuf(ch, 2 * b + 1, 1) = bin_time;
+            } else {
+                bbuf(ch, b, 0) = stats.count ? static_cast<float>(stats.sum / stats.count) : 0.0f;
+                bbuf(ch, b, 1) = bin_time;
             }
-            bbuf(ch, b, 0) = sum_val / count;
-            bbuf(ch, b, 1) = bin_time;
         }
     }
 
-    return {binned_bufs, triggered, trig_start};
+}
+
+void ADC::_record_frame_timing(const Capture& cap, double prev_end_s) {
+    const auto to_ns = [](double s) { return static_cast<uint64_t>(std::max(s, 0.0) * 1e9); };
+
+    ++_acq_frames;
+    _acq_live_total_ns += to_ns(static_cast<double>(cap.words.size()) * cap.dt);
+    if (prev_end_s < 0.0) return;
+
+    const uint64_t dead_ns = to_ns(cap.t0 - prev_end_s);
+    _dead_time.record(std::chrono::nanoseconds(dead_ns));
+    _acq_dead_last_ns   = dead_ns;
+    _acq_dead_total_ns += dead_ns;
+    if (dead_ns > _acq_dead_max_ns.load()) _acq_dead_max_ns = dead_ns;  // worker is the only writer
+}
+
+AcquisitionStats ADC::acquisition_stats() const {
+    AcquisitionStats stats;
+
+    stats.wait    = _stage_times[int(WorkerStage::WAIT)].get();
+    stats.convert = _stage_times[int(WorkerStage::CONVERT)].get();
+    stats.analyze = _stage_times[int(WorkerStage::ANALYZE)].get();
+    stats.publish = _stage_times[int(WorkerStage::PUBLISH)].get();
+    stats.period  = _stage_times[int(WorkerStage::PERIOD)].get();
+    stats.trigger_latency = _trigger_latency.get();
+    stats.rearm           = _rearm_time.get();
+
+    stats.frames            = _acq_frames.load();
+    stats.overruns          = _acq_overruns.load();
+    stats.stream_restarts   = _acq_stream_restarts.load();
+    stats.la_missed_samples = _acq_la_missed.load();
+    stats.dma_timeouts      = _acq_dma_timeouts.load();
+    stats.dma_errors        = _acq_dma_errors.load();
+    stats.frames_unread     = _acq_unread.load();
+    stats.dead_time_last_s  = 1e-9 * _acq_dead_last_ns.load();
+    stats.dead_time_max_s   = 1e-9 * _acq_dead_max_ns.load();
+    stats.dead_time_total_s = 1e-9 * _acq_dead_total_ns.load();
+    stats.live_time_total_s = 1e-9 * _acq_live_total_ns.load();
+    return stats;
+}
+
+void ADC::reset_acquisition_stats() {
+    _acq_frames        = 0;
+    _acq_overruns      = 0;
+    _acq_stream_restarts = 0;
+    _acq_la_missed       = 0;
+    _acq_dma_timeouts  = 0;
+    _acq_dma_errors    = 0;
+    _acq_unread        = 0;
+    _acq_dead_last_ns  = 0;
+    _acq_dead_max_ns   = 0;
+    _acq_dead_total_ns = 0;
+    _acq_live_total_ns = 0;
+    for (auto& t : _stage_times) t.reset();
+    _trigger_latency.reset();
+    _rearm_time.reset();
+    _dma_wait_time.reset();
+    _dead_time.reset();
+    _reader_lock_wait.reset();
+    _reconfig_time.reset();
+    _bin_time.reset();
+    _reader_period.reset();
+    _wake_lateness.reset();
+}
+
+static py::list histogram_list(const Log2Histogram& hist) {
+    py::list counts;
+    for (int b = 0; b < Log2Histogram::N_BUCKETS; ++b) counts.append(hist.count(b));
+    return counts;
+}
+
+static py::dict timing_dict(const TimingAccumulator& acc) {
+    const StageTiming t = acc.get();
+    const Log2Histogram& hist = acc.histogram();
+    return py::dict(
+        "count"_a=acc.count(),
+        "mean_us"_a=t.mean_us,
+        "max_us"_a=t.max_us,
+        "p50_us"_a=1e-3 * hist.quantile_ns(0.5),
+        "p99_us"_a=1e-3 * hist.quantile_ns(0.99),
+        "histogram"_a=histogram_list(hist)
+    );
+}
+
+py::dict ADC::telemetry() const {
+    py::dict timings(
+        "wait"_a=timing_dict(_stage_times[int(WorkerStage::WAIT)]),
+        "dma_wait"_a=timing_dict(_dma_wait_time),
+        "convert"_a=timing_dict(_stage_times[int(WorkerStage::CONVERT)]),
+        "analyze"_a=timing_dict(_stage_times[int(WorkerStage::ANALYZE)]),
+        "publish"_a=timing_dict(_stage_times[int(WorkerStage::PUBLISH)]),
+        "period"_a=timing_dict(_stage_times[int(WorkerStage::PERIOD)]),
+        "dead_time"_a=timing_dict(_dead_time),
+        "trigger_latency"_a=timing_dict(_trigger_latency),
+        "rearm"_a=timing_dict(_rearm_time),
+        "reader_lock_wait"_a=timing_dict(_reader_lock_wait),
+        "bin"_a=timing_dict(_bin_time),
+        "reader_period"_a=timing_dict(_reader_period),
+        "reconfig"_a=timing_dict(_reconfig_time)
+    );
+
+    const VCPoolStats pool = vc_pool_stats();
+    py::dict vc_pool(
+        "requests"_a=pool.requests,
+        "reused"_a=pool.reused,
+        "vc_allocs"_a=pool.vc_allocs,
+        "vc_releases"_a=pool.vc_releases,
+        "blocks_in_use"_a=pool.blocks_in_use,
+        "bytes_in_use"_a=pool.bytes_in_use,
+        "blocks_idle"_a=pool.blocks_idle,
+        "bytes_idle"_a=pool.bytes_idle,
+        "peak_bytes"_a=pool.peak_bytes
+    );
+
+    const AcquisitionStats stats = acquisition_stats();
+    return py::dict(
+        "frames"_a=stats.frames,
+        "frames_unread"_a=stats.frames_unread,
+        "frames_discarded"_a=_frames_discarded.load(),
+        "overruns"_a=stats.overruns,
+        "dma_timeouts"_a=stats.dma_timeouts,
+        "dma_errors"_a=stats.dma_errors,
+        "dead_fraction"_a=stats.dead_fraction(),
+        "buffers_cache_hits"_a=_buffers_cache_hits.load(),
+        "buffers_cache_misses"_a=_buffers_cache_misses.load(),
+        "timings"_a=timings,
+        "vc_pool"_a=vc_pool,
+        "wake_lateness_histogram"_a=histogram_list(_wake_lateness)
+    );
+}
+
+void ADC::reset_buffers_cache_stats() {
+    _buffers_cache_hits   = 0;
+    _buffers_cache_misses = 0;
+}
+
+void ADC::_invalidate_buffers_cache() {
+    // Keep the arrays so the next misses can reuse them.
+    std::lock_guard<std::mutex> lock(_cache_mutex);
+    for (auto& entry : _buffers_cache) {
+        entry.last_used = 0;
+    }
+    _rebuilt_gen = 0;
+    _rebuilt_table_version = 0;
 }
 
 bool ADC::channel_active(int ch) const {
@@ -363,4 +1226,5 @@ bool ADC::channel_active(int ch) const {
 
 void ADC::toggle_channel(int channel_idx) {
     _active_channels[channel_idx] = !_active_channels[channel_idx];
+    _invalidate_buffers_cache();
 }
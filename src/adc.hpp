@@ -1,4 +1,7 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <tuple>
@@ -7,22 +10,205 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <chrono>
+#include <memory>
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
 
+#include "minmax_pyramid.hpp"
 #include "peripherals/dma/dma.hpp"
 #include "peripherals/gpio/gpio.hpp"
 #include "peripherals/pwm/pwm.hpp"
+#include "peripherals/smi/smi.hpp"
+#include "utils/log2_histogram.hpp"
+#include "utils/realtime.hpp"
 #include "utils/reg_mem_utils.hpp"
+#include "utils/triple_buffer.hpp"
 
 namespace py = pybind11;
 
+class CaptureRecorder;
+struct RecordingStats;
+
 enum class TrigMode {
     NONE,
     RISING_EDGE,
     FALLING_EDGE
 };
 
+// Which captures the worker publishes when a trigger mode is set.
+enum class TrigSweep {
+    AUTO,   // every capture, triggered or not
+    NORMAL  // only triggered captures; the rest are dropped in the worker
+};
+
+// Trigger settings the worker applies to each new capture.
+struct TriggerSettings {
+    TrigMode                mode         = TrigMode::RISING_EDGE;
+    std::pair<float, float> thresh       = {0.5f, 2.5f};
+    bool                    auto_range   = false;
+    int                     skip_samples = 0;
+    TrigSweep               sweep        = TrigSweep::AUTO;
+};
+
+// How get_buffers() reduces the samples that fall in one screen bin.
+enum class Decimation {
+    MEAN,  // one point per bin: the mean
+    PEAK   // two points per bin: min then max (peak-detect envelope)
+};
+
+// How LA mode samples GPIO 8-23.
+enum class LABackend {
+    AUTO,  // SMI, or PWM for rates the SMI timing can't reach
+    SMI,   // SMI reads of the pins as its data lines, a few CBs per buffer
+    PWM    // a PWM-paced DMA read of GPLEV0 per sample; slow but any rate
+};
+
+// Where one channel's raw code sits inside each stored sample word.
+struct ChannelField {
+    bool     active = false;
+    int      shift  = 0;
+    uint32_t mask   = 0;
+};
+
+// Volts for every raw code. Immutable once built: a rebuild (VREF, bit
+// format, calibration, LA mode) makes a new table with the next version, and
+// captures keep the one they were analyzed with.
+struct CodeTable {
+    std::vector<float>      volts;
+    std::pair<float, float> vref;  // the ADC's VREF when it was built
+    uint64_t                version = 0;
+};
+
+// One completed capture: one 16-bit word per sample holding every channel's
+// raw code, plus the time base. Volts and timestamps are only produced on
+// demand by get_buffers(), from the per-channel pyramids the worker builds
+// once per capture.
+struct Capture {
+    std::vector<uint16_t>      words;
+    std::vector<ChannelField>  channels;
+    std::vector<MinMaxPyramid> pyramids;  // one per channel, empty if inactive
+    std::shared_ptr<const CodeTable> codes;  // the table the pyramids were built with
+    uint64_t gen = 0; // generation number, assigned when published
+    double t0 = 0.0;  // capture start, seconds on the steady clock
+    double dt = 0.0;  // sample period in seconds; 0 until the first capture
+
+    // Trigger result, found by the worker with the settings in effect for
+    // this capture.
+    int                skip_samples = 0;
+    bool               triggered = false;
+    std::optional<int> trig_start;
+};
+
+// get_buffers() arguments plus the capture generation they apply to.
+struct BuffersKey {
+    uint64_t                  gen = 0;
+    int                       screen_width = 0;
+    std::pair<double, double> x_range;
+    Decimation                decimation = Decimation::MEAN;
+    uint64_t                  table_version = 0;  // code table the bins are in
+
+    bool operator==(const BuffersKey&) const = default;
+};
+
+// Steps of one worker iteration, timed separately. The next transfer is
+// started at the end of WAIT, so CONVERT onwards overlaps it.
+enum class WorkerStage {
+    WAIT,     // sleeping and waiting for the transfer in flight
+    CONVERT,  // _finish_fetch(): receive memory -> capture words
+    ANALYZE,  // pyramids and trigger search
+    PUBLISH,  // handing the capture to readers
+    PERIOD,   // the whole iteration
+    COUNT
+};
+
+struct StageTiming {
+    double mean_us = 0.0;
+    double max_us  = 0.0;
+};
+
+// Running mean, max and log2 histogram of one duration. One thread at a
+// time records, any reads.
+class TimingAccumulator {
+public:
+    void record(std::chrono::steady_clock::duration d) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        const auto ns_u = static_cast<uint64_t>(std::max<int64_t>(ns, 0));
+        _total_ns += ns_u;
+        if (ns_u > _max_ns.load()) _max_ns = ns_u;  // single writer
+        _hist.record(ns_u);
+        ++_count;
+    }
+
+    uint64_t count() const { return _count.load(); }
+    const Log2Histogram& histogram() const { return _hist; }
+
+    StageTiming get() const {
+        const uint64_t n = _count.load();
+        return {
+            .mean_us = n ? 1e-3 * static_cast<double>(_total_ns.load()) / static_cast<double>(n) : 0.0,
+            .max_us  = 1e-3 * static_cast<double>(_max_ns.load())
+        };
+    }
+
+    void reset() {
+        _count = 0;
+        _total_ns = 0;
+        _max_ns = 0;
+        _hist.reset();
+    }
+
+private:
+    std::atomic<uint64_t> _count{0};
+    std::atomic<uint64_t> _total_ns{0};
+    std::atomic<uint64_t> _max_ns{0};
+    Log2Histogram         _hist;
+};
+
+// Records its own lifetime into a TimingAccumulator.
+class ScopedTiming {
+public:
+    explicit ScopedTiming(TimingAccumulator& acc) : _acc(acc), _start(std::chrono::steady_clock::now()) {}
+    ~ScopedTiming() { _acc.record(std::chrono::steady_clock::now() - _start); }
+
+    ScopedTiming(const ScopedTiming&) = delete;
+    ScopedTiming& operator=(const ScopedTiming&) = delete;
+
+private:
+    TimingAccumulator&                    _acc;
+    std::chrono::steady_clock::time_point _start;
+};
+
+// Acquisition health, counted by the worker since the last reset. Dead time
+// is the gap between the last sample of one capture and the first sample of
+// the next, i.e. signal nobody saw.
+struct AcquisitionStats {
+    uint64_t frames   = 0;  // captures collected (published or not)
+    uint64_t overruns = 0;  // continuous mode: ring segments lost to a slow consumer
+    uint64_t stream_restarts = 0;  // continuous mode: SMI count ran out or the stream stalled
+    uint64_t la_missed_samples = 0;  // PWM-paced LA: ticks the read loop was too slow to sample
+    uint64_t dma_timeouts = 0;  // transfers still running at their deadline (dropped)
+    uint64_t dma_errors   = 0;  // transfers the DMA flagged as failed (dropped)
+    uint64_t frames_unread = 0;  // published, then replaced before any reader took them
+    double   dead_time_last_s  = 0.0;
+    double   dead_time_max_s   = 0.0;
+    double   dead_time_total_s = 0.0;
+    double   live_time_total_s = 0.0;  // time covered by collected samples
+
+    // Per-capture worker stage times.
+    StageTiming wait, convert, analyze, publish, period;
+
+    // From a published capture's trigger sample to its publication, and
+    // (pre-trigger mode, capture_segments()) from the end of a triggered
+    // frame to scanning live data again.
+    StageTiming trigger_latency, rearm;
+
+    double dead_fraction() const {
+        const double total_s = dead_time_total_s + live_time_total_s;
+        return (total_s > 0.0) ? dead_time_total_s / total_s : 0.0;
+    }
+};
+
 class ADC {
 public:
     ADC(std::pair<float, float> vref, int n_samples, int n_channels);
@@ -35,23 +221,139 @@ public:
     virtual void toggle_channel(int channel_idx);
     bool channel_active(int ch) const;
 
+    // Bin the latest published capture for display. Returns the bins plus
+    // the trigger result the worker found for that capture. The bins are
+    // read-only: repeated calls with the same arguments share one array.
     virtual std::tuple<py::array_t<float>, bool, std::optional<int>> get_buffers(
         int screen_width,
         std::pair<double, double> x_range = {0.0, -1.0},
-        bool auto_range = false,
+        Decimation decimation = Decimation::MEAN
+    );
+
+    // Raw codes of the newest published capture, without copying. The
+    // returned read-only array keeps the capture pinned for as long as it
+    // (or any view of it) is alive, and the worker never writes into a pinned
+    // capture; it switches to spare captures instead. Each word holds every
+    // active channel's code at the field given in the metadata. Decode a
+    // field through the metadata's code_table, which with VREF is the one
+    // the capture was converted with, not necessarily the current one.
+    std::tuple<py::array_t<uint16_t>, py::dict> raw_capture();
+
+    // Takes effect from the next capture. Thresholds are in the same units
+    // as get_buffers() values; with auto_range they are instead derived from
+    // channel 0's range.
+    void set_trigger(
+        TrigMode mode,
         std::pair<float, float> thresh = {0.5f, 2.5f},
-        TrigMode trig_mode = TrigMode::RISING_EDGE,
-        int skip_samples = 0
+        bool auto_range = false,
+        int skip_samples = 0,
+        TrigSweep sweep = TrigSweep::AUTO
+    );
+    TriggerSettings trigger_settings() const;
+
+    // Captures dropped by the worker in NORMAL sweep for lack of a trigger.
+    uint64_t frames_discarded() const { return _frames_discarded.load(); }
+
+    AcquisitionStats acquisition_stats() const;
+
+    // Everything in acquisition_stats() plus a histogram per timing, for
+    // working out where a slow update rate comes from: the worker's stages,
+    // the readers' lock waits and binning, and the gap between get_buffers()
+    // calls, which is mostly the caller's own time. Each timing maps to
+    // {count, mean_us, max_us, p50_us, p99_us, histogram}, where histogram[b]
+    // counts [2^(b-1), 2^b) ns as in Log2Histogram.
+    py::dict telemetry() const;
+
+    // Zeroes acquisition_stats(), telemetry() and the wake lateness histogram.
+    void reset_acquisition_stats();
+
+    // Segmented acquisition for bursty signals: n_segments records of
+    // segment_samples each, one per trigger under the current trigger
+    // settings, captured back to back without returning to Python. Each
+    // record has the trigger pre_fraction of the way in. Returns the records
+    // as one [records, n_active_channels, segment_samples] array of volts and
+    // each record's trigger time in cntvct_el0 ticks. Returns fewer records
+    // if timeout_s runs out first. The worker is paused for the duration, and
+    // acquisition_stats().rearm times the gap between records.
+    std::tuple<py::array_t<float>, py::array_t<uint64_t>> capture_segments(
+        int n_segments, int segment_samples, float pre_fraction = 0.1f, double timeout_s = 10.0
     );
 
+    // Record every completed capture's raw codes to path until
+    // stop_recording(). A writer thread does the file I/O, so the worker
+    // never waits on the disk. max_bytes > 0 preallocates the file and caps
+    // it. Frames that do not fit, or that find all queue_frames slots taken,
+    // are dropped and counted. See capture_recorder.hpp for the file layout;
+    // RecordingReader maps it back.
+    void start_recording(const std::string& path, uint64_t max_bytes = 0, int queue_frames = 32);
+    RecordingStats stop_recording();
+    RecordingStats recording_stats() const;
+    bool recording() const { return _recorder != nullptr; }
+
+    // 0 for offset-binary codes, 1 for two's complement.
+    virtual int bit_format() const { return 0; }
+
+    // Counts of how late the worker woke from its sleeps while waiting on
+    // the DMA; bucket b counts [2^(b-1), 2^b) ns (see Log2Histogram).
+    std::vector<uint64_t> wake_lateness_histogram() const;
+
+    // Scheduling for the worker thread, kept across worker restarts: pin it
+    // to cpu (-1 for any; the isolcpus core osc.bash reserves is 3), run it
+    // SCHED_FIFO at fifo_priority (0 for normal scheduling), and mlockall()
+    // so page faults cannot stall it. Applied straight away, to the running
+    // worker or to a stand-in thread, so a refusal throws here and leaves
+    // the previous settings in force.
+    void set_realtime(int cpu = 3, int fifo_priority = 80, bool lock_memory = true);
+    RealtimeSettings realtime_settings() const { return _rt_settings; }
+
+    // What the running worker actually got; empty cpus when it is stopped.
+    RealtimeStatus realtime_status();
+
+    // Wait on DMA completion interrupts through a UIO device fd (e.g. an
+    // opened /dev/uioN bound to the channel's interrupt) instead of polling.
+    // -1 goes back to polling. The caller keeps ownership of the fd. The
+    // PWM-paced LA path polls either way.
+    void set_dma_irq_fd(int fd);
+    int dma_irq_fd() const { return _dma_irq_fd; }
+
+    // The VC memory pool behind the capture buffers and CBs (see
+    // Mailbox::alloc_vc_mem()). With pooling off every resize and LA mode
+    // switch frees and reallocates, for comparing telemetry()'s reconfig
+    // timing with and without the pool.
+    VCPoolStats vc_pool_stats() const { return _dma._mbox.vc_pool_stats(); }
+    bool vc_pooling() const { return _dma._mbox.vc_pooling(); }
+    void set_vc_pooling(bool enable) { _dma._mbox.set_vc_pooling(enable); }
+
     std::pair<float, float> VREF() const { return _VREF; }
+    void set_VREF(std::pair<float, float> vref);
+
+    // Volts for every raw code. Rebuilt only when VREF, the bit format or the
+    // calibration changes; every decode path indexes it.
+    const std::vector<float>& code_table() const { return _codes->volts; }
+
+    // Per-code correction in volts (e.g. measured INL) added to the ideal
+    // transfer function. Must have one entry per code; empty clears it.
+    void set_code_calibration(const std::vector<float>& correction);
     int n_samples() const { return _n_samples; }
     int n_channels() const { return _n_channels; }
     uint64_t data_generation() const { return _front_gen.load(); }
 
+    // get_buffers() caches its last few results. Repeated calls with the same
+    // arguments and no new capture return the same array, so callers must
+    // treat results as read-only.
+    uint64_t buffers_cache_hits() const { return _buffers_cache_hits.load(); }
+    uint64_t buffers_cache_misses() const { return _buffers_cache_misses.load(); }
+    void reset_buffers_cache_stats();
+
     void set_logic_analyzer_mode(bool enable, int n_bits = 8);
     bool logic_analyzer_mode() const { return _logic_analyzer_mode; }
 
+    // Takes effect at the next start_sampling(). la_active_backend() is the
+    // one the last LA start_sampling() settled on.
+    void set_la_backend(LABackend backend);
+    LABackend la_backend() const { return _la_backend; }
+    LABackend la_active_backend() const { return _la_active; }
+
 protected:
     std::pair<float, float> _VREF;
     int _n_samples;
@@ -61,30 +363,179 @@ protected:
     bool _logic_analyzer_mode = false;
     int _logic_analyzer_n_bits = 8;
 
+    std::shared_ptr<const CodeTable> _codes = std::make_shared<CodeTable>();
+    std::vector<float> _code_calibration;  // per-code correction, empty if none
+
+    // Replace _codes with a table built from _code_to_float() and
+    // _code_calibration. In LA mode the codes are single GPIO bits and the
+    // table maps them to 0/1. Only with the worker stopped.
+    void _rebuild_code_table();
+
     // Shared hardware peripherals — owned here, used by both subclasses and LA mode.
     DMA _dma;
     GPIO _gpio;
     PWM _pwm{/*use_fifo=*/true};
+    SMI _smi;
     AddressSpaceInfo _asi;
 
-    // LA uses DMA channel 9 (same value as _dma_chan_0 in both subclasses, but
-    // LA and non-LA modes are mutually exclusive so there is no conflict).
-    static constexpr int _la_dma_chan = 9;
+    // Claimed from the process-wide registry. LA captures use it, and so do
+    // the subclasses' own transfers: LA and non-LA modes are mutually
+    // exclusive so there is no conflict.
+    DMAChannel _dma_chan;
 
-    // LA GPIO capture buffer
+    // A full channel for the PWM-paced LA path's pacer, held only while
+    // that path is set up.
+    DMAChannel _la_pace_chan;
+
+    // LA GPIO capture buffers: two of _n_samples words each, so one can be
+    // filled while the other is converted, with LA_PAD_WORDS before, between
+    // and after them for the PWM path's pacer to run through.
+    static constexpr int LA_PAD_WORDS = 32;
+    // Written over the PWM path's buffer before each capture, so words the
+    // read loop never got to can be told apart (see _finish_la_fetch()).
+    static constexpr uint32_t LA_UNWRITTEN = 0x5a3cc3a5;
     MemPtrs   _la_data;
     uint32_t* _la_rx_data_virt = nullptr;
     uint32_t* _la_rx_data_bus  = nullptr;
+    int       _la_rx_fill  = 0;  // buffer the DMA is writing
+    int       _la_rx_ready = 0;  // last completed buffer
+    int       _la_first_cb[2] = {};  // where each buffer's chain starts
+    int       _la_read_cb = 0;       // PWM path: the read loop's first CB
+
+    // Word offset of LA buffer b in _la_data.
+    int _la_buf_ofs(int b) const { return LA_PAD_WORDS + b * (_n_samples + LA_PAD_WORDS); }
+
+    LABackend _la_backend = LABackend::AUTO;
+    LABackend _la_active  = LABackend::SMI;  // what the LA CBs are built for
 
     // Async worker infrastructure
     std::thread        _worker_thread;
     std::atomic<bool>  _running{false};
-    std::mutex         _buf_mutex;
-    std::atomic<uint64_t> _front_gen{0};
-    py::array_t<float> _front_bufs;  // latest completed data, read by get_buffers()
-    py::array_t<float> _back_bufs;   // worker writes here during _finish_fetch()
+    std::chrono::steady_clock::time_point _fetch_started;  // set by the worker before each _start_fetch()
+    RealtimeSettings   _rt_settings;  // applied to each new worker thread
+
+    // DMA completion waits. The expected duration of a transfer is its
+    // nominal duration times _xfer_time_ratio, learned from completions the
+    // wait actually observed; the sleep margin follows _wake_lateness.
+    int           _dma_irq_fd = -1;
+    double        _xfer_time_ratio = 1.0;  // worker-only
+    Log2Histogram _wake_lateness;
+
+    // Wait for a transfer on channel started at `started` that nominally
+    // takes nominal_s, and count timeouts and errors. use_irq=false polls
+    // even with an fd set, for channels it isn't bound to.
+    DMAWaitStatus _wait_dma(
+        int channel, std::chrono::steady_clock::time_point started, double nominal_s,
+        bool use_irq = true
+    );
+    std::atomic<uint64_t> _front_gen{0};  // generation of the newest published capture
+
+    // Worker -> reader handoff. Slots hold shared captures: the worker fills
+    // its write slot and publishes it without ever blocking, and readers pin
+    // the newest capture by copying the pointer out of the read slot. Reader
+    // threads serialize on _reader_mutex, which the worker never takes. The
+    // worker only writes into captures nobody else holds.
+    TripleBuffer<std::shared_ptr<Capture>> _frames;
+    std::mutex _reader_mutex;
+    std::vector<std::shared_ptr<Capture>> _pinned_captures;  // worker-only: captures still held by readers
+
+    // Newest published capture, pinned for the caller.
+    std::shared_ptr<const Capture> _pin_latest();
+
+    // Make the write slot's capture writable: keep it if unshared, else park
+    // it and take a parked (or new) capture that nobody holds. Worker only.
+    void _recycle_write_slot();
+
+    mutable std::mutex    _trig_mutex;
+    TriggerSettings       _trig_settings;
+    std::atomic<uint64_t> _frames_discarded{0};
+
+    // AcquisitionStats counters, written by the worker. Times in ns.
+    std::atomic<uint64_t> _acq_frames{0};
+    std::atomic<uint64_t> _acq_overruns{0};
+    std::atomic<uint64_t> _acq_stream_restarts{0};
+    std::atomic<uint64_t> _acq_la_missed{0};
+    std::atomic<uint64_t> _acq_dma_timeouts{0};
+    std::atomic<uint64_t> _acq_dma_errors{0};
+    std::atomic<uint64_t> _acq_unread{0};
+    std::atomic<uint64_t> _acq_dead_last_ns{0};
+    std::atomic<uint64_t> _acq_dead_max_ns{0};
+    std::atomic<uint64_t> _acq_dead_total_ns{0};
+    std::atomic<uint64_t> _acq_live_total_ns{0};
+
+    static constexpr int N_WORKER_STAGES = static_cast<int>(WorkerStage::COUNT);
+    std::array<TimingAccumulator, N_WORKER_STAGES> _stage_times;
+    TimingAccumulator _trigger_latency;
+    TimingAccumulator _rearm_time;
+    TimingAccumulator _dma_wait_time;     // inside DMA::wait_done()
+    TimingAccumulator _dead_time;
+    TimingAccumulator _reader_lock_wait;  // readers queueing on _reader_mutex
+    TimingAccumulator _reconfig_time;     // resize() and LA mode switches
+
+    // Set while recording; only swapped with the worker stopped. The mutex
+    // keeps recording_stats() off a recorder being torn down.
+    std::unique_ptr<CaptureRecorder> _recorder;
+    mutable std::mutex               _recorder_mutex;
+
+    // Account one collected capture; prev_end_s is the end of the previous
+    // one (< 0 for the first capture since the worker started).
+    void _record_frame_timing(const Capture& cap, double prev_end_s);
+
+    void _resize_captures(int n_channels, int n_samples);
+    // Build channel ch's pyramid with cap.codes.
+    void _build_pyramid(Capture& cap, int ch) const;
+
+    // Trigger search on channel 0 of cap; fills cap's trigger fields.
+    void _find_trigger(Capture& cap, const TriggerSettings& trig) const;
+
+    // True if _finish_fetch() already filled the trigger fields (the backend
+    // triggered while acquiring), so the worker must not search again.
+    virtual bool _fetch_sets_trigger() const { return false; }
 
-    void _resize_flat_bufs(int n_channels, int n_samples);
+    // Convert channel ch of cap, samples [begin, end), to volts through
+    // cap.codes.
+    void _decode_channel(const Capture& cap, int ch, int begin, int end, float* dst) const;
+
+    // get_buffers() result cache, guarded by _cache_mutex. Entries stay keyed
+    // on a generation, so they go stale on their own when a new capture is
+    // published, and on the code table version; settings that change the
+    // data otherwise (channels, size, LA mode) invalidate it explicitly.
+    struct BuffersCacheEntry {
+        BuffersKey         key;
+        py::array_t<float> bufs;
+        uint64_t           last_used = 0;  // 0 = empty slot
+    };
+    std::mutex _cache_mutex;
+    static constexpr int _buffers_cache_size = 4;
+    std::array<BuffersCacheEntry, _buffers_cache_size> _buffers_cache;
+    uint64_t _buffers_cache_clock = 0;
+    std::atomic<uint64_t> _buffers_cache_hits{0};
+    std::atomic<uint64_t> _buffers_cache_misses{0};
+
+    // get_buffers() telemetry, recorded under _cache_mutex.
+    TimingAccumulator _bin_time;       // cache misses: binning a capture
+    TimingAccumulator _reader_period;  // from one call to the next
+    std::chrono::steady_clock::time_point _last_get_buffers{};
+
+    // A published capture's pyramids rebuilt with a newer code table than
+    // it was analyzed with, kept for the capture and table they were built
+    // for. Guarded by _cache_mutex.
+    std::vector<MinMaxPyramid> _rebuilt_pyramids;
+    uint64_t _rebuilt_gen = 0;
+    uint64_t _rebuilt_table_version = 0;
+
+    void _invalidate_buffers_cache();
+
+    // cap's pyramids if they were built with codes, else _rebuilt_pyramids
+    // (rebuilt first if need be). Under _cache_mutex.
+    const std::vector<MinMaxPyramid>& _pyramids_for(const Capture& cap, const CodeTable& codes);
+
+    // Bin cap into out, which is already shaped [n_channels, points, 2],
+    // through codes and the matching pyramids.
+    void _bin_capture(
+        const Capture& cap, const CodeTable& codes, const std::vector<MinMaxPyramid>& pyramids,
+        const BuffersKey& key, py::array_t<float>& out
+    ) const;
     void _start_worker(double rate_hz);
     void _stop_worker();
     void _worker_loop(double rate_hz);
@@ -93,15 +544,19 @@ protected:
     void _la_alloc_buf(int n_samples);
     void _la_free_buf();
 
-    // Set up the pairs of PWM-gated GPIO-read DMA CBs for _n_samples samples.
+    // Set up the LA chains for _la_active: one of chunked SMI reads per
+    // buffer, or a PWM pacer CB per buffer plus a GPIO read loop they share.
     void _setup_la_dma_cbs();
 
-    // Called by subclass start_sampling() in LA mode after the rate is cached.
-    void _la_start_sampling(uint32_t rate_hz);
+    // Called by subclass start_sampling() in LA mode: picks the backend for
+    // rate_hz, sets up the pins and pacing for it and returns the rate it
+    // actually runs at. The subclass caches that, then starts the worker.
+    uint32_t _la_setup_sampling(uint32_t rate_hz);
 
-    // LA fetch steps — called from subclass _start/_finish/_abort_fetch.
+    // LA fetch steps — called from subclass _start/_wait/_finish/_abort_fetch.
     void _start_la_fetch();
-    void _finish_la_fetch(float* target);
+    bool _wait_la_fetch();
+    void _finish_la_fetch(Capture& target);
     void _abort_la_fetch();
 
     // Re-allocates LA buffer and DMA CBs for a new sample count.
@@ -112,9 +567,36 @@ protected:
     // non-LA buffers and DMA CBs.
     virtual void _on_la_mode_exit() = 0;
 
-    // Subclass data-acquisition interface
+    // Rebuild the subclass's (non-LA) DMA CBs for the current settings.
+    virtual void _setup_dma_cbs() = 0;
+
+    // Width and ideal transfer function of the subclass's raw codes.
+    virtual int   _code_bits() const = 0;
+    virtual float _code_to_float(uint32_t code) const = 0;
+
+    // Subclass data-acquisition interface. Each backend has two receive
+    // buffers: _start_fetch() starts a transfer into the free one,
+    // _wait_fetch() blocks until it completes and marks it ready, and
+    // _finish_fetch() converts the ready buffer. The worker starts the next
+    // transfer between _wait_fetch() and _finish_fetch(). _wait_fetch()
+    // returns false if the transfer failed; nothing is marked ready then.
     virtual void   _start_fetch() = 0;
-    virtual void   _finish_fetch(float* target) = 0;
+    virtual bool   _wait_fetch() = 0;
+    virtual void   _finish_fetch(Capture& target) = 0;
     virtual void   _abort_fetch() {}
     virtual double _get_sample_rate_hz() const = 0;
+
+    // Backend half of capture_segments(), called with the worker stopped and
+    // the GIL released: write up to n_segments records of segment_samples
+    // words to words, their trigger times to stamps, and the channel fields
+    // of the words to channels. Returns the number of records captured.
+    virtual int _capture_segments(
+        int n_segments, int segment_samples, float pre_fraction, double timeout_s,
+        uint16_t* words, uint64_t* stamps, std::vector<ChannelField>& channels
+    );
+
+    // How long the worker can sleep before _wait_fetch(), given the transfer
+    // in flight started elapsed_s ago. By default not at all: the DMA wait
+    // does its own sleeping.
+    virtual double _fetch_lead_time_s(double rate_hz, double elapsed_s) const;
 };
@@ -0,0 +1,586 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "minmax_pyramid.hpp"
+#include "utils/realtime.hpp"
+#include "utils/triple_buffer.hpp"
+#include "sample_kernels.hpp"
+
+// Host-side checks and microbenchmarks for the sample-processing kernels.
+// Only depends on portable code, so it builds and runs on x86 as well as on
+// the Pi. Run with no arguments for every section, or name the sections to
+// run. Exits non-zero if a kernel disagrees with its scalar reference.
+
+static bool ok = true;
+
+// Time fn() and return the mean over n_iters calls in microseconds.
+static double time_us(const std::function<void()>& fn, int n_iters) {
+    fn();  // warm up
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n_iters; ++i) {
+        fn();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / n_iters;
+}
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cout << "MISMATCH: " << what << std::endl;
+        ok = false;
+    }
+}
+
+// ---- decode ------------------------------------------------------------------
+
+static void bench_decode() {
+    std::cout << "== decode (ns/sample: SIMD, scalar ref)" << std::endl;
+
+    std::mt19937 rng(1234);
+    constexpr int max_samples = 262144;
+    std::vector<uint16_t> words(max_samples);
+    for (auto& w : words) w = rng() & 0xffff;
+    std::vector<uint32_t> gpio_words(max_samples);
+    for (auto& w : gpio_words) w = rng();
+
+    const std::pair<float, float> vref = {-0.95f, 0.95f};
+    std::vector<uint16_t> codes(max_samples), codes_ref(max_samples);
+    std::vector<float> out(max_samples), out_ref(max_samples);
+
+    std::vector<float> u8_table(256);
+    for (uint32_t c = 0; c < 256; ++c) {
+        u8_table[c] = sample_kernels::u8_to_float(c, SampleFormat::TWOS_COMPLEMENT, vref);
+    }
+
+    const auto codes_match = [&](int n) {
+        return std::memcmp(codes.data(), codes_ref.data(), n * sizeof(uint16_t)) == 0;
+    };
+    const auto out_match = [&](int n) {
+        return std::memcmp(out.data(), out_ref.data(), n * sizeof(float)) == 0;
+    };
+
+    for (const int n : {511, 512, 16384, 262144}) {
+        const int n_iters = std::max(1, 4000000 / n);
+        const std::string n_str = "n=" + std::to_string(n);
+
+        const double t_pk = time_us([&] {
+            sample_kernels::unpack_packed_u8(words.data(), n, codes.data());
+        }, n_iters);
+        const double t_pk_ref = time_us([&] {
+            sample_kernels::ref::unpack_packed_u8(words.data(), n, codes_ref.data());
+        }, n_iters);
+        check(codes_match(n), "unpack_packed_u8 " + n_str);
+
+        const double t_cp = time_us([&] {
+            sample_kernels::copy_words(words.data(), n, codes.data());
+        }, n_iters);
+        const double t_cp_ref = time_us([&] {
+            sample_kernels::ref::copy_words(words.data(), n, codes_ref.data());
+        }, n_iters);
+        check(codes_match(n), "copy_words " + n_str);
+
+        const double t_spi = time_us([&] {
+            sample_kernels::unpack_spi_u10((const uint8_t*)words.data(), n, codes.data());
+        }, n_iters);
+        const double t_spi_ref = time_us([&] {
+            sample_kernels::ref::unpack_spi_u10((const uint8_t*)words.data(), n, codes_ref.data());
+        }, n_iters);
+        check(codes_match(n), "unpack_spi_u10 " + n_str);
+
+        const double t_la = time_us([&] {
+            sample_kernels::extract_gpio_field(gpio_words.data(), n, 8, 0xffff, codes.data());
+        }, n_iters);
+        const double t_la_ref = time_us([&] {
+            sample_kernels::ref::extract_gpio_field(gpio_words.data(), n, 8, 0xffff, codes_ref.data());
+        }, n_iters);
+        check(codes_match(n), "extract_gpio_field " + n_str);
+
+        // Channel 1 of dual-channel words: the high byte.
+        const double t_dec = time_us([&] {
+            sample_kernels::decode_field(words.data(), n, 8, 0xff, u8_table.data(), out.data());
+        }, n_iters);
+        const double t_dec_ref = time_us([&] {
+            sample_kernels::ref::decode_field(words.data(), n, 8, 0xff, u8_table.data(), out_ref.data());
+        }, n_iters);
+        check(out_match(n), "decode_field " + n_str);
+
+        // Per-sample arithmetic, the conversion the table replaces.
+        for (int i = 0; i < n; ++i) {
+            out_ref[i] = sample_kernels::u8_to_float(words[i] >> 8, SampleFormat::TWOS_COMPLEMENT, vref);
+        }
+        check(out_match(n), "decode_field vs arithmetic " + n_str);
+
+        std::cout << "  " << n_str
+                  << "  packed u8: " << (1e3 * t_pk / n) << ", " << (1e3 * t_pk_ref / n)
+                  << "  words: " << (1e3 * t_cp / n) << ", " << (1e3 * t_cp_ref / n)
+                  << "  spi u10: " << (1e3 * t_spi / n) << ", " << (1e3 * t_spi_ref / n)
+                  << "  gpio: " << (1e3 * t_la / n) << ", " << (1e3 * t_la_ref / n)
+                  << "  decode: " << (1e3 * t_dec / n) << ", " << (1e3 * t_dec_ref / n)
+                  << std::endl;
+    }
+
+    // A capture stores one 16-bit word per sample for all channels; the old
+    // float storage kept a (value, time) pair per sample per channel.
+    for (const int n_ch : {1, 2}) {
+        const size_t code_bytes  = max_samples * sizeof(uint16_t);
+        const size_t float_bytes = (size_t)n_ch * max_samples * 2 * sizeof(float);
+        std::cout << "  storage, " << n_ch << " ch, n=" << max_samples << ": "
+                  << code_bytes / 1024 << " KiB codes vs " << float_bytes / 1024 << " KiB floats"
+                  << std::endl;
+    }
+}
+
+// ---- minmax ------------------------------------------------------------------
+
+static void bench_minmax() {
+    std::cout << "== minmax (ns/sample: SIMD, scalar ref, mean for comparison)" << std::endl;
+
+    std::mt19937 rng(5678);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    constexpr int max_samples = 262144;
+    std::vector<float> vals(max_samples);
+    for (auto& v : vals) v = dist(rng);
+
+    // Odd bin sizes to exercise the tails; 1 is the most zoomed-in case.
+    for (const int bin_size : {1, 3, 7, 64, 327}) {
+        const int n_bins = max_samples / bin_size;
+        std::vector<float> lo(n_bins), hi(n_bins), lo_ref(n_bins), hi_ref(n_bins), mean(n_bins);
+
+        const double t_mm = time_us([&] {
+            for (int b = 0; b < n_bins; ++b) {
+                sample_kernels::minmax_f32(vals.data() + b * bin_size, bin_size, &lo[b], &hi[b]);
+            }
+        }, 20);
+        const double t_mm_ref = time_us([&] {
+            for (int b = 0; b < n_bins; ++b) {
+                sample_kernels::ref::minmax_f32(vals.data() + b * bin_size, bin_size, &lo_ref[b], &hi_ref[b]);
+            }
+        }, 20);
+        check(lo == lo_ref && hi == hi_ref, "minmax_f32 bin=" + std::to_string(bin_size));
+
+        const double t_mean = time_us([&] {
+            for (int b = 0; b < n_bins; ++b) {
+                float sum = 0;
+                for (int i = 0; i < bin_size; ++i) sum += vals[b * bin_size + i];
+                mean[b] = sum / bin_size;
+            }
+        }, 20);
+
+        const int n = n_bins * bin_size;
+        std::cout << "  bin=" << bin_size
+                  << "  " << (1e3 * t_mm / n) << ", " << (1e3 * t_mm_ref / n) << ", " << (1e3 * t_mean / n)
+                  << std::endl;
+    }
+}
+
+// ---- pyramid -----------------------------------------------------------------
+
+// Same bin edges as ADC::get_buffers().
+static std::pair<int, int> bin_edges(int b, int win_start, int win_end, float bins_to_samples) {
+    int s_start = win_start + static_cast<int>(b * bins_to_samples);
+    int s_end   = win_start + static_cast<int>((b + 1) * bins_to_samples);
+    if (s_end > win_end) s_end = win_end;
+    if (s_start >= s_end) {
+        // Fewer samples than bins: every bin still gets one sample.
+        s_start = std::max(win_start, s_end - 1);
+        s_end   = s_start + 1;
+    }
+    return {s_start, s_end};
+}
+
+static void bench_pyramid() {
+    std::cout << "== pyramid (us per channel: linear binning, pyramid build, pyramid query)" << std::endl;
+
+    constexpr int screen_width = 800;
+    std::mt19937 rng(91011);
+
+    std::vector<float> table(256);
+    for (uint32_t c = 0; c < 256; ++c) {
+        table[c] = sample_kernels::u8_to_float(c, SampleFormat::TWOS_COMPLEMENT, {-0.95f, 0.95f});
+    }
+
+    for (const int n : {512, 2048, 8192, 32768, 131072, 262144}) {
+        std::vector<uint16_t> words(n);
+        for (auto& w : words) w = rng() & 0xffff;
+
+        // Fully zoomed out, then an off-center 1/8th of the buffer.
+        for (const int zoom : {1, 8}) {
+            const int win_start = (zoom == 1) ? 0 : n / 3;
+            const int win_end   = win_start + n / zoom;
+            const float bins_to_samples = static_cast<float>(win_end - win_start) / screen_width;
+
+            std::vector<float> lin_min(screen_width), lin_max(screen_width), lin_mean(screen_width);
+            std::vector<float> pyr_min(screen_width), pyr_max(screen_width), pyr_mean(screen_width);
+            std::vector<float> win_vals(win_end - win_start);
+
+            // The pre-pyramid path: decode the window, then walk every bin.
+            const double t_lin = time_us([&] {
+                sample_kernels::decode_field(
+                    words.data() + win_start, win_end - win_start, 8, 0xff, table.data(), win_vals.data()
+                );
+                for (int b = 0; b < screen_width; ++b) {
+                    const auto [s_start, s_end] = bin_edges(b, win_start, win_end, bins_to_samples);
+                    const float* vals = win_vals.data() + (s_start - win_start);
+                    sample_kernels::minmax_f32(vals, s_end - s_start, &lin_min[b], &lin_max[b]);
+                    double sum = 0.0;
+                    for (int i = 0; i < s_end - s_start; ++i) sum += vals[i];
+                    lin_mean[b] = static_cast<float>(sum / (s_end - s_start));
+                }
+            }, std::max(1, 2000000 / n));
+
+            MinMaxPyramid pyr;
+            const double t_build = time_us([&] {
+                pyr.build(words.data(), n, 8, 0xff, table.data());
+            }, std::max(1, 2000000 / n));
+
+            const double t_query = time_us([&] {
+                for (int b = 0; b < screen_width; ++b) {
+                    const auto [s_start, s_end] = bin_edges(b, win_start, win_end, bins_to_samples);
+                    const auto stats = pyr.query(words.data(), table.data(), s_start, s_end);
+                    pyr_min[b]  = stats.min;
+                    pyr_max[b]  = stats.max;
+                    pyr_mean[b] = static_cast<float>(stats.sum / stats.count);
+                }
+            }, 200);
+
+            float max_mean_err = 0.0f;
+            for (int b = 0; b < screen_width; ++b) {
+                max_mean_err = std::max(max_mean_err, std::abs(pyr_mean[b] - lin_mean[b]));
+            }
+            const std::string what = "n=" + std::to_string(n) + " zoom=" + std::to_string(zoom);
+            check(pyr_min == lin_min && pyr_max == lin_max, "pyramid min/max " + what);
+            check(max_mean_err < 1e-5f, "pyramid mean " + what);
+
+            std::cout << "  " << what << "  " << t_lin << ", " << t_build << ", " << t_query << std::endl;
+        }
+    }
+}
+
+// ---- trigger -----------------------------------------------------------------
+
+static void bench_trigger() {
+    std::cout << "== trigger (ns/sample: SIMD, scalar ref)" << std::endl;
+
+    constexpr int n = 262144;
+    constexpr float pi = 3.14159265f;
+    std::mt19937 rng(1213);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+
+    struct Waveform {
+        std::string name;
+        std::vector<float> vals;
+    };
+    std::vector<Waveform> waves = {
+        {"sine", std::vector<float>(n)},
+        {"square", std::vector<float>(n)},
+        {"noise", std::vector<float>(n)},
+        {"flat", std::vector<float>(n)},
+    };
+    for (int i = 0; i < n; ++i) {
+        // Sine: 1000-sample period, so edges come early and often.
+        waves[0].vals[i] = std::sin(2.0f * pi * i / 1000.0f);
+        // Square: a single late edge, three quarters of the way in.
+        waves[1].vals[i] = (i < 3 * n / 4) ? -1.0f : 1.0f;
+        waves[2].vals[i] = noise(rng);
+        // Flat: never crosses either threshold, so the whole buffer is scanned.
+        waves[3].vals[i] = 0.0f;
+    }
+
+    for (const auto& wave : waves) {
+        for (const bool rising : {true, false}) {
+            const float* vals = wave.vals.data();
+            int armed = -1, armed_ref = -1;
+            int hit = -1, hit_ref = -1;
+
+            // Chunked like get_buffers(), so armed_at is carried across calls.
+            const auto search = [&](auto find, int& hit_out, int& armed_out) {
+                armed_out = -1;
+                hit_out = -1;
+                for (int start = 0; start < n && hit_out < 0; start += 1024) {
+                    hit_out = find(vals + start, std::min(1024, n - start), -0.2f, 0.2f, rising, start, &armed_out);
+                }
+            };
+            const double t = time_us([&] { search(sample_kernels::find_edge, hit, armed); }, 50);
+            const double t_ref = time_us([&] { search(sample_kernels::ref::find_edge, hit_ref, armed_ref); }, 50);
+            check(hit == hit_ref && armed == armed_ref,
+                  "find_edge " + wave.name + (rising ? " rising" : " falling"));
+
+            // Per sample actually searched, so early and late triggers compare.
+            const int n_searched = (hit >= 0) ? hit + 1 : n;
+            std::cout << "  " << wave.name << (rising ? " rising " : " falling")
+                      << "  hit=" << hit << " armed=" << armed
+                      << "  " << (1e3 * t / n_searched) << ", " << (1e3 * t_ref / n_searched)
+                      << std::endl;
+        }
+    }
+
+    // Edge cases for the block logic: arm and fire in the same block, fire
+    // before arm in a block, low > high (a sample can both arm and fire).
+    for (int trial = 0; trial < 2000; ++trial) {
+        std::vector<float> v(37);
+        for (auto& x : v) x = static_cast<float>(static_cast<int>(rng() % 5) - 2);
+        const float low  = static_cast<float>(static_cast<int>(rng() % 5) - 2);
+        const float high = static_cast<float>(static_cast<int>(rng() % 5) - 2);
+        for (const bool rising : {true, false}) {
+            int armed = -1, armed_ref = -1;
+            const int hit = sample_kernels::find_edge(v.data(), 37, low, high, rising, 100, &armed);
+            const int hit_ref = sample_kernels::ref::find_edge(v.data(), 37, low, high, rising, 100, &armed_ref);
+            check(hit == hit_ref && armed == armed_ref, "find_edge random trial " + std::to_string(trial));
+        }
+    }
+
+    std::cout << "== fused min/max/sum (ns/sample: fused SIMD, scalar ref, minmax + separate sum)" << std::endl;
+    for (const auto& wave : waves) {
+        float lo, hi, sum, lo_ref, hi_ref, sum_ref;
+        const double t = time_us([&] {
+            sample_kernels::minmax_sum_f32(wave.vals.data(), n, &lo, &hi, &sum);
+        }, 50);
+        const double t_ref = time_us([&] {
+            sample_kernels::ref::minmax_sum_f32(wave.vals.data(), n, &lo_ref, &hi_ref, &sum_ref);
+        }, 50);
+        const double t_two = time_us([&] {
+            sample_kernels::minmax_f32(wave.vals.data(), n, &lo_ref, &hi_ref);
+            float s = 0.0f;
+            for (int i = 0; i < n; ++i) s += wave.vals[i];
+            sum_ref = s;
+        }, 50);
+        check(lo == lo_ref && hi == hi_ref, "minmax_sum_f32 " + wave.name);
+        check(std::abs(sum - sum_ref) <= 1e-3f * n, "minmax_sum_f32 sum " + wave.name);
+
+        std::cout << "  " << wave.name
+                  << "  " << (1e3 * t / n) << ", " << (1e3 * t_ref / n) << ", " << (1e3 * t_two / n)
+                  << std::endl;
+    }
+}
+
+// ---- handoff -----------------------------------------------------------------
+
+struct LatencyStats {
+    std::vector<double> ns;
+
+    std::string summary() {
+        if (ns.empty()) return "-";
+        std::sort(ns.begin(), ns.end());
+        const auto pct = [&](double p) { return ns[std::min(ns.size() - 1, size_t(p * ns.size()))]; };
+        return "p50 " + std::to_string(int(pct(0.5))) + " / p99 " + std::to_string(int(pct(0.99)))
+             + " / max " + std::to_string(int(ns.back())) + " ns";
+    }
+};
+
+static double ns_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A frame big enough that copying it under a lock is noticeable, filled with
+// its sequence number so a reader can detect torn (half-written) frames.
+struct StressFrame {
+    uint64_t seq = 0;
+    std::vector<uint64_t> data = std::vector<uint64_t>(16384);
+};
+
+struct HandoffResult {
+    LatencyStats publish;    // writer: time to hand over one frame
+    LatencyStats lock_wait;  // readers: time waiting for the reader lock
+    uint64_t published = 0, unread = 0, reads = 0, new_frames = 0, torn = 0, backwards = 0;
+};
+
+// Writer publishes frames every period_ns (0 = flat out) for duration_ms
+// while n_readers threads poll for the newest frame and verify it.
+// lock_free selects the triple buffer; otherwise the old mutex + swap scheme,
+// where readers hold the lock while they copy the front frame.
+static HandoffResult run_handoff(bool lock_free, int n_readers, int period_ns, int duration_ms) {
+    HandoffResult res;
+    std::atomic<bool> done{false};
+
+    TripleBuffer<StressFrame> tb;
+    tb.reset(StressFrame{});
+    std::mutex reader_mutex;
+
+    StressFrame front, back;
+    std::mutex swap_mutex;
+
+    std::vector<HandoffResult> per_reader(n_readers);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < n_readers; ++r) {
+        readers.emplace_back([&, r] {
+            auto& mine = per_reader[r];
+            StressFrame copy;
+            uint64_t last_seq = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                const auto wait_start = std::chrono::steady_clock::now();
+                const StressFrame* frame;
+                std::unique_lock<std::mutex> lock;
+                if (lock_free) {
+                    lock = std::unique_lock<std::mutex>(reader_mutex);
+                    mine.lock_wait.ns.push_back(ns_since(wait_start));
+                    tb.update();
+                    frame = &tb.read_slot();
+                } else {
+                    lock = std::unique_lock<std::mutex>(swap_mutex);
+                    mine.lock_wait.ns.push_back(ns_since(wait_start));
+                    copy = front;  // the snapshot copy the old get_buffers made
+                    lock.unlock();
+                    frame = &copy;
+                }
+
+                ++mine.reads;
+                const uint64_t seq = frame->seq;
+                for (const uint64_t v : frame->data) {
+                    if (v != seq) { ++mine.torn; break; }
+                }
+                if (seq < last_seq) ++mine.backwards;
+                if (seq != last_seq) ++mine.new_frames;
+                last_seq = seq;
+            }
+        });
+    }
+
+    const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(duration_ms);
+    auto next = std::chrono::steady_clock::now();
+    for (uint64_t seq = 1; std::chrono::steady_clock::now() < end; ++seq) {
+        StressFrame& frame = lock_free ? tb.write_slot() : back;
+        frame.seq = seq;
+        std::fill(frame.data.begin(), frame.data.end(), seq);
+
+        const auto start = std::chrono::steady_clock::now();
+        if (lock_free) {
+            res.unread += tb.publish();
+        } else {
+            std::lock_guard<std::mutex> lock(swap_mutex);
+            std::swap(front, back);
+        }
+        res.publish.ns.push_back(ns_since(start));
+        ++res.published;
+
+        if (period_ns > 0) {
+            next += std::chrono::nanoseconds(period_ns);
+            while (std::chrono::steady_clock::now() < next) {}
+        }
+    }
+    done = true;
+    for (auto& t : readers) t.join();
+
+    for (auto& r : per_reader) {
+        res.reads += r.reads;
+        res.new_frames += r.new_frames;
+        res.torn += r.torn;
+        res.backwards += r.backwards;
+        res.lock_wait.ns.insert(res.lock_wait.ns.end(), r.lock_wait.ns.begin(), r.lock_wait.ns.end());
+    }
+    return res;
+}
+
+static void bench_handoff() {
+    std::cout << "== handoff (writer -> readers stress: triple buffer vs mutex + swap)" << std::endl;
+
+    // 0 = writer flat out; 10 us = 100k frames/s; 1 ms = a typical capture.
+    for (const int period_ns : {0, 10000, 1000000}) {
+        for (const int n_readers : {1, 2, 4}) {
+            for (const bool lock_free : {true, false}) {
+                auto res = run_handoff(lock_free, n_readers, period_ns, 300);
+                const std::string what = std::string(lock_free ? "triple" : "mutex ")
+                    + " period=" + std::to_string(period_ns) + "ns readers=" + std::to_string(n_readers);
+
+                check(res.torn == 0 && res.backwards == 0, "handoff consistency " + what);
+
+                std::cout << "  " << what
+                          << "  published " << res.published << " (unread " << res.unread << ")"
+                          << ", reads " << res.reads << " (new " << res.new_frames << ")"
+                          << ", torn " << res.torn << std::endl
+                          << "      publish " << res.publish.summary()
+                          << ", reader lock wait " << res.lock_wait.summary() << std::endl;
+            }
+        }
+    }
+}
+
+// ---- wakeup ------------------------------------------------------------------
+
+// How late a thread wakes from short sleeps: what the worker pays on every
+// DMA wait. Run once with default scheduling and once pinned at SCHED_FIFO
+// with memory locked, if the kernel allows it (root or CAP_SYS_NICE).
+static void run_wakeups(const std::string& label, const std::optional<RealtimeSettings>& settings) {
+    constexpr int n_wakes = 5000;
+    const auto period = std::chrono::microseconds(200);
+
+    LatencyStats lateness;
+    std::string refused;
+    std::thread sleeper([&] {
+        std::optional<ScopedRealtime> rt;
+        if (settings) {
+            try {
+                rt.emplace(*settings);
+            } catch (const std::runtime_error& e) {
+                refused = e.what();
+                return;
+            }
+        }
+
+        auto next = std::chrono::steady_clock::now();
+        for (int i = 0; i < n_wakes; ++i) {
+            next += period;
+            std::this_thread::sleep_until(next);
+            lateness.ns.push_back(ns_since(next));
+        }
+    });
+    sleeper.join();
+
+    if (!refused.empty()) {
+        std::cout << "  " << label << "  skipped: " << refused << std::endl;
+    } else {
+        std::cout << "  " << label << "  " << lateness.summary() << std::endl;
+    }
+}
+
+static void bench_wakeup() {
+    std::cout << "== wakeup (lateness of 200 us sleeps)" << std::endl;
+
+    // The last isolated CPU if the kernel has any (isolcpus=3 on the Pi),
+    // else the last CPU.
+    const std::string isolated = realtime_status(pthread_self()).isolated_cpus;
+    int cpu = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+    const auto last_digit = isolated.find_last_of("0123456789");
+    if (last_digit != std::string::npos) {
+        const auto first_digit = isolated.find_last_not_of("0123456789", last_digit) + 1;
+        cpu = std::stoi(isolated.substr(first_digit, last_digit - first_digit + 1));
+    }
+    std::cout << "  isolated CPUs: " << (isolated.empty() ? "none" : isolated) << std::endl;
+
+    run_wakeups("default         ", std::nullopt);
+    run_wakeups("cpu " + std::to_string(cpu) + " SCHED_FIFO",
+                RealtimeSettings{.cpu=cpu, .fifo_priority=80, .lock_memory=true});
+}
+
+int main(int argc, char** argv) {
+    const std::vector<std::pair<std::string, std::function<void()>>> sections = {
+        {"decode", bench_decode},
+        {"minmax", bench_minmax},
+        {"pyramid", bench_pyramid},
+        {"trigger", bench_trigger},
+        {"handoff", bench_handoff},
+        {"wakeup", bench_wakeup},
+    };
+
+    for (const auto& [name, fn] : sections) {
+        bool run = (argc < 2);
+        for (int i = 1; i < argc; ++i) {
+            run |= (name == argv[i]);
+        }
+        if (run) fn();
+    }
+
+    std::cout << (ok ? "All kernels match their references." : "Kernel mismatches found.") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -4,6 +4,7 @@ using namespace pybind11::literals;
 namespace py = pybind11;
 
 #include "adc.hpp"
+#include "capture_recorder.hpp"
 #include "parallel_adc.hpp"
 #include "serial_adc.hpp"
 
@@ -19,16 +20,162 @@ PYBIND11_MODULE(adc_interfaces, m, py::mod_gil_not_used()) {
         .value("FALLING_EDGE", TrigMode::FALLING_EDGE)
         .export_values();
 
+    py::enum_<TrigSweep>(m, "TrigSweep")
+        .value("AUTO", TrigSweep::AUTO)
+        .value("NORMAL", TrigSweep::NORMAL)
+        .export_values();
+
+    py::enum_<LABackend>(m, "LABackend")
+        .value("AUTO", LABackend::AUTO)
+        .value("SMI", LABackend::SMI)
+        .value("PWM", LABackend::PWM)
+        .export_values();
+
+    py::enum_<Decimation>(m, "Decimation")
+        .value("MEAN", Decimation::MEAN)
+        .value("PEAK", Decimation::PEAK)
+        .export_values();
+
+    py::class_<StageTiming>(m, "StageTiming")
+        .def_readonly("mean_us", &StageTiming::mean_us)
+        .def_readonly("max_us", &StageTiming::max_us);
+
+    py::class_<AcquisitionStats>(m, "AcquisitionStats")
+        .def_readonly("frames", &AcquisitionStats::frames)
+        .def_readonly("overruns", &AcquisitionStats::overruns)
+        .def_readonly("stream_restarts", &AcquisitionStats::stream_restarts)
+        .def_readonly("la_missed_samples", &AcquisitionStats::la_missed_samples)
+        .def_readonly("dma_timeouts", &AcquisitionStats::dma_timeouts)
+        .def_readonly("dma_errors", &AcquisitionStats::dma_errors)
+        .def_readonly("frames_unread", &AcquisitionStats::frames_unread)
+        .def_readonly("dead_time_last_s", &AcquisitionStats::dead_time_last_s)
+        .def_readonly("dead_time_max_s", &AcquisitionStats::dead_time_max_s)
+        .def_readonly("dead_time_total_s", &AcquisitionStats::dead_time_total_s)
+        .def_readonly("live_time_total_s", &AcquisitionStats::live_time_total_s)
+        .def_readonly("wait", &AcquisitionStats::wait)
+        .def_readonly("convert", &AcquisitionStats::convert)
+        .def_readonly("analyze", &AcquisitionStats::analyze)
+        .def_readonly("publish", &AcquisitionStats::publish)
+        .def_readonly("period", &AcquisitionStats::period)
+        .def_readonly("trigger_latency", &AcquisitionStats::trigger_latency)
+        .def_readonly("rearm", &AcquisitionStats::rearm)
+        .def_property_readonly("dead_fraction", &AcquisitionStats::dead_fraction);
+
+    // Bound in both modules, so local to each.
+    py::class_<RealtimeStatus>(m, "RealtimeStatus", py::module_local())
+        .def_readonly("cpus", &RealtimeStatus::cpus)
+        .def_readonly("fifo", &RealtimeStatus::fifo)
+        .def_readonly("priority", &RealtimeStatus::priority)
+        .def_readonly("memory_locked", &RealtimeStatus::memory_locked)
+        .def_readonly("isolated_cpus", &RealtimeStatus::isolated_cpus);
+
+    py::class_<RecordingStats>(m, "RecordingStats")
+        .def_readonly("frames_written", &RecordingStats::frames_written)
+        .def_readonly("frames_dropped", &RecordingStats::frames_dropped)
+        .def_readonly("bytes_written", &RecordingStats::bytes_written)
+        .def_readonly("elapsed_s", &RecordingStats::elapsed_s)
+        .def_readonly("throughput_mb_s", &RecordingStats::throughput_mb_s)
+        .def_readonly("queue_high_water", &RecordingStats::queue_high_water)
+        .def_readonly("direct_io", &RecordingStats::direct_io)
+        .def_readonly("error", &RecordingStats::error);
+
+    py::class_<VCPoolStats>(m, "VCPoolStats")
+        .def_readonly("requests", &VCPoolStats::requests)
+        .def_readonly("reused", &VCPoolStats::reused)
+        .def_readonly("vc_allocs", &VCPoolStats::vc_allocs)
+        .def_readonly("vc_releases", &VCPoolStats::vc_releases)
+        .def_readonly("blocks_in_use", &VCPoolStats::blocks_in_use)
+        .def_readonly("bytes_in_use", &VCPoolStats::bytes_in_use)
+        .def_readonly("blocks_idle", &VCPoolStats::blocks_idle)
+        .def_readonly("bytes_idle", &VCPoolStats::bytes_idle)
+        .def_readonly("peak_bytes", &VCPoolStats::peak_bytes);
+
+    // Array properties are views into the mapping and keep the reader alive.
+    py::class_<RecordingReader>(m, "RecordingReader")
+        .def(py::init<const std::string&>(), py::arg("path"))
+        .def_property_readonly("n_frames", &RecordingReader::n_frames)
+        .def_property_readonly("sample_rate_hz", [](const RecordingReader& r) { return r.header().sample_rate_hz; })
+        .def_property_readonly("VREF", [](const RecordingReader& r) {
+            return std::make_pair(r.header().vref_low, r.header().vref_high);
+        })
+        .def_property_readonly("bit_format", [](const RecordingReader& r) { return r.header().bit_format; })
+        .def_property_readonly("code_bits", [](const RecordingReader& r) { return r.header().code_bits; })
+        .def_property_readonly("frame_samples", [](const RecordingReader& r) { return r.header().frame_samples; })
+        .def_property_readonly("n_channels", [](const RecordingReader& r) { return r.header().n_channels; })
+        .def_property_readonly("channel_mask", [](const RecordingReader& r) { return r.header().channel_mask; })
+        .def_property_readonly("start_unix_s", [](const RecordingReader& r) { return r.header().start_unix_s; })
+        .def_property_readonly("start_steady_s", [](const RecordingReader& r) { return r.header().start_steady_s; })
+        .def_property_readonly("frames_dropped", [](const RecordingReader& r) { return r.header().frames_dropped; })
+        .def_property_readonly("code_table", [](const RecordingReader& r) {
+            const auto& h = r.header();
+            return std::vector<float>(h.code_table, h.code_table + h.n_codes);
+        })
+        .def_property_readonly("words", [](py::object self) {
+            const auto& r = self.cast<const RecordingReader&>();
+            const py::ssize_t n = r.n_frames();
+            const py::ssize_t rec = r.header().record_bytes;
+            return py::array_t<uint16_t>(
+                {n, py::ssize_t(r.header().frame_samples)}, {rec, py::ssize_t(sizeof(uint16_t))},
+                reinterpret_cast<const uint16_t*>(r.records() + sizeof(RecordedFrame)), self
+            );
+        })
+        .def_property_readonly("index", [](py::object self) {
+            const auto& r = self.cast<const RecordingReader&>();
+            return py::array_t<uint64_t>(
+                {py::ssize_t(r.n_frames())}, {py::ssize_t(r.header().record_bytes)},
+                reinterpret_cast<const uint64_t*>(r.records() + offsetof(RecordedFrame, index)), self
+            );
+        })
+        .def_property_readonly("t0", [](py::object self) {
+            const auto& r = self.cast<const RecordingReader&>();
+            return py::array_t<double>(
+                {py::ssize_t(r.n_frames())}, {py::ssize_t(r.header().record_bytes)},
+                reinterpret_cast<const double*>(r.records() + offsetof(RecordedFrame, t0)), self
+            );
+        })
+        .def("decode", [](const RecordingReader& r, int channel, uint64_t first, int64_t count) {
+            const uint64_t n = (count < 0) ? r.n_frames() - std::min(first, r.n_frames()) : uint64_t(count);
+            py::array_t<float> out({py::ssize_t(n), py::ssize_t(r.header().frame_samples)});
+            r.decode(channel, first, n, out.mutable_data());
+            return out;
+        }, py::arg("channel"), py::arg("first_frame")=0, py::arg("n_frames")=-1);
+
     py::class_<ADC>(m, "ADC")
         .def("get_buffers", &ADC::get_buffers,
              py::arg("screen_width"),
              py::arg("x_range")=std::make_pair(0.0, -1.0),
-             py::arg("auto_range")=false,
+             py::arg("decimation")=Decimation::MEAN
+        )
+        .def("raw_capture", &ADC::raw_capture)
+        .def("set_trigger", &ADC::set_trigger,
+             py::arg("trig_mode"),
              py::arg("thresh")=std::make_pair(0.5f, 2.5f),
-             py::arg("trig_mode")=TrigMode::RISING_EDGE,
-             py::arg("skip_samples")=0
+             py::arg("auto_range")=false,
+             py::arg("skip_samples")=0,
+             py::arg("sweep")=TrigSweep::AUTO
         )
-        .def_property("VREF", &ADC::VREF, nullptr)
+        .def_property_readonly("frames_discarded", &ADC::frames_discarded)
+        .def_property_readonly("acquisition_stats", &ADC::acquisition_stats)
+        .def("reset_acquisition_stats", &ADC::reset_acquisition_stats)
+        .def_property_readonly("telemetry", &ADC::telemetry)
+        .def_property_readonly("wake_lateness_histogram", &ADC::wake_lateness_histogram)
+        .def("capture_segments", &ADC::capture_segments,
+             py::arg("n_segments"), py::arg("segment_samples"),
+             py::arg("pre_fraction")=0.1f, py::arg("timeout_s")=10.0)
+        .def_property("dma_irq_fd", &ADC::dma_irq_fd, &ADC::set_dma_irq_fd)
+        .def("set_realtime", &ADC::set_realtime,
+             py::arg("cpu")=3, py::arg("fifo_priority")=80, py::arg("lock_memory")=true)
+        .def_property_readonly("realtime_status", &ADC::realtime_status)
+        .def("start_recording", &ADC::start_recording,
+             py::arg("path"), py::arg("max_bytes")=0, py::arg("queue_frames")=32)
+        .def("stop_recording", &ADC::stop_recording)
+        .def_property_readonly("recording_stats", &ADC::recording_stats)
+        .def_property_readonly("recording", &ADC::recording)
+        .def_property_readonly("vc_pool_stats", &ADC::vc_pool_stats)
+        .def_property("vc_pooling", &ADC::vc_pooling, &ADC::set_vc_pooling)
+        .def_property("VREF", &ADC::VREF, &ADC::set_VREF)
+        .def_property_readonly("code_table", &ADC::code_table)
+        .def("set_code_calibration", &ADC::set_code_calibration, py::arg("correction"))
         .def("start_sampling", &ADC::start_sampling)
         .def("stop_sampling", &ADC::stop_sampling)
         .def("toggle_channel", &ADC::toggle_channel)
@@ -40,7 +187,12 @@ PYBIND11_MODULE(adc_interfaces, m, py::mod_gil_not_used()) {
              py::arg("n_bits")=8
         )
         .def_property_readonly("logic_analyzer_mode", &ADC::logic_analyzer_mode)
+        .def_property("la_backend", &ADC::la_backend, &ADC::set_la_backend)
+        .def_property_readonly("la_active_backend", &ADC::la_active_backend)
         .def_property_readonly("data_generation", &ADC::data_generation)
+        .def_property_readonly("buffers_cache_hits", &ADC::buffers_cache_hits)
+        .def_property_readonly("buffers_cache_misses", &ADC::buffers_cache_misses)
+        .def("reset_buffers_cache_stats", &ADC::reset_buffers_cache_stats)
         .def_property_readonly("n_samples", &ADC::n_samples)
         .def_property_readonly("n_channels", &ADC::n_channels);
 
@@ -66,5 +218,14 @@ PYBIND11_MODULE(adc_interfaces, m, py::mod_gil_not_used()) {
             py::arg("bit_format")=1
         )
         .def("set_attenuation", &ParallelADC::set_attenuation,
-             py::arg("channel"), py::arg("att_on"));
+             py::arg("channel"), py::arg("att_on"))
+        .def_property("bit_format", &ParallelADC::bit_format, &ParallelADC::set_bit_format)
+        .def("set_continuous", &ParallelADC::set_continuous,
+             py::arg("enable"), py::arg("n_segments")=4)
+        .def_property_readonly("continuous", &ParallelADC::continuous)
+        .def_property_readonly("n_ring_segments", &ParallelADC::n_ring_segments)
+        .def("set_pretrigger", &ParallelADC::set_pretrigger,
+             py::arg("enable"), py::arg("pre_fraction")=0.1f)
+        .def_property_readonly("pretrigger", &ParallelADC::pretrigger)
+        .def_property_readonly("pretrigger_fraction", &ParallelADC::pretrigger_fraction);
 }
@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "capture_recorder.hpp"
+#include "sample_kernels.hpp"
+
+static size_t round_up(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+static std::string errno_str() {
+    return std::strerror(errno);
+}
+
+// ---- CaptureRecorder ------------------------------------------------------
+
+CaptureRecorder::CaptureRecorder(
+    const std::string& path, const RecordingHeader& header, uint64_t max_bytes, int queue_frames
+) :
+    _header(header),
+    _max_bytes(max_bytes),
+    _n_slots(queue_frames)
+{
+    if (queue_frames < 1) {
+        throw std::runtime_error("A recording needs at least one queue slot.");
+    }
+    if (header.frame_samples < 1) {
+        throw std::runtime_error("A recording needs a positive frame size.");
+    }
+
+    std::memcpy(_header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+    _header.version        = RECORDING_VERSION;
+    _header.header_bytes   = RECORDING_HEADER_BYTES;
+    _header.record_bytes   = sizeof(RecordedFrame) + sizeof(uint16_t) * header.frame_samples;
+    _header.n_frames       = 0;
+    _header.frames_dropped = 0;
+
+    if (max_bytes > 0 && max_bytes < RECORDING_HEADER_BYTES + _header.record_bytes) {
+        throw std::runtime_error("max_bytes is too small to hold a single frame.");
+    }
+
+    // O_DIRECT keeps a long recording from evicting everything else from the
+    // page cache. Filesystems without it (tmpfs) refuse it with EINVAL.
+    _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    _direct_io = (_fd >= 0);
+    if (_fd < 0 && errno == EINVAL) {
+        _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (_fd < 0) {
+        throw std::runtime_error("Failed to open " + path + ": " + errno_str());
+    }
+
+    if (max_bytes > 0) {
+        const int err = posix_fallocate(_fd, 0, static_cast<off_t>(max_bytes));
+        if (err != 0) {
+            ::close(_fd);
+            throw std::runtime_error("Failed to preallocate " + path + ": " + std::strerror(err));
+        }
+    }
+
+    // The staging buffer holds at least one record past a partial block.
+    _staging_bytes = std::max(STAGING_BYTES, round_up(_header.record_bytes + BLOCK_BYTES, BLOCK_BYTES));
+    _slots   = static_cast<uint8_t*>(std::aligned_alloc(64, round_up(size_t(_n_slots) * _header.record_bytes, 64)));
+    _staging = static_cast<uint8_t*>(std::aligned_alloc(BLOCK_BYTES, _staging_bytes));
+    if (!_slots || !_staging) {
+        std::free(_slots);
+        std::free(_staging);
+        ::close(_fd);
+        throw std::runtime_error("Failed to allocate recording buffers.");
+    }
+
+    // Written again on close(); until then n_frames == 0 marks it unfinished.
+    _started = std::chrono::steady_clock::now();
+    _write_header();
+
+    _writer = std::thread(&CaptureRecorder::_writer_loop, this);
+}
+
+CaptureRecorder::~CaptureRecorder() {
+    close();
+    std::free(_slots);
+    std::free(_staging);
+}
+
+void CaptureRecorder::push(const Capture& cap) {
+    const uint64_t index = _next_index++;
+    const uint64_t head  = _head.load(std::memory_order_relaxed);
+    const uint64_t depth = head - _tail.load(std::memory_order_acquire);
+
+    const bool right_size = (cap.words.size() == size_t(_header.frame_samples));
+    const bool fits = (
+        _max_bytes == 0
+        || RECORDING_HEADER_BYTES + (_accepted + 1) * _header.record_bytes <= _max_bytes
+    );
+    if (!right_size || !fits || depth >= uint64_t(_n_slots)) {
+        ++_frames_dropped;
+        return;
+    }
+
+    // The channel layout only changes with a worker restart, so the first
+    // frame's describes them all. close() writes it out.
+    if (!_have_channels) {
+        const int n_ch = std::min<int>(cap.channels.size(), RECORDING_MAX_CHANNELS);
+        _header.n_channels   = n_ch;
+        _header.channel_mask = 0;
+        for (int ch = 0; ch < n_ch; ++ch) {
+            if (cap.channels[ch].active) _header.channel_mask |= 1u << ch;
+            _header.channel_shift[ch]     = cap.channels[ch].shift;
+            _header.channel_code_mask[ch] = cap.channels[ch].mask;
+        }
+        _have_channels = true;
+    }
+
+    uint8_t* rec = _slots + (head % _n_slots) * _header.record_bytes;
+    const RecordedFrame info{.index=index, .t0=cap.t0};
+    std::memcpy(rec, &info, sizeof(info));
+    std::memcpy(rec + sizeof(info), cap.words.data(), cap.words.size() * sizeof(uint16_t));
+    ++_accepted;
+
+    _head.store(head + 1, std::memory_order_release);
+    if (static_cast<int>(depth + 1) > _queue_high_water.load(std::memory_order_relaxed)) {
+        _queue_high_water.store(static_cast<int>(depth + 1), std::memory_order_relaxed);
+    }
+    _wake.notify_one();
+}
+
+void CaptureRecorder::_writer_loop() {
+    const size_t rec_bytes = _header.record_bytes;
+    bool ok = true;
+
+    while (true) {
+        const uint64_t head = _head.load(std::memory_order_acquire);
+        uint64_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == head) {
+            if (_closing.load()) break;
+
+            // push() notifies without taking the lock, so a wakeup can slip
+            // in just before the wait; the timeout bounds what that costs.
+            std::unique_lock<std::mutex> lock(_wake_mutex);
+            _wake.wait_for(lock, std::chrono::milliseconds(10));
+            continue;
+        }
+
+        for (; tail < head; ++tail) {
+            if (ok && _staged + rec_bytes > _staging_bytes) ok = _flush(false);
+            if (ok) {
+                std::memcpy(_staging + _staged, _slots + (tail % _n_slots) * rec_bytes, rec_bytes);
+                _staged += rec_bytes;
+                ++_frames_written;
+            } else {
+                ++_frames_dropped;
+            }
+            // Hand the slot back as soon as it is copied.
+            _tail.store(tail + 1, std::memory_order_release);
+        }
+    }
+
+    if (ok) _flush(true);
+}
+
+bool CaptureRecorder::_flush(bool final) {
+    // Only whole blocks go out until the end, so every write stays aligned.
+    const size_t n_bytes = final ? round_up(_staged, BLOCK_BYTES) : _staged / BLOCK_BYTES * BLOCK_BYTES;
+    if (n_bytes == 0) return true;
+
+    if (final) std::memset(_staging + _staged, 0, n_bytes - _staged);
+    if (!_write_at(_staging, n_bytes, _file_pos)) return false;
+
+    const size_t rest = _staged - std::min(_staged, n_bytes);
+    std::memmove(_staging, _staging + n_bytes, rest);
+    _bytes_written += _staged - rest;
+    _file_pos += n_bytes;
+    _staged = rest;
+
+    _last_write_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - _started
+    ).count());
+    return true;
+}
+
+bool CaptureRecorder::_write_at(const void* data, size_t n_bytes, uint64_t offset) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    while (n_bytes > 0) {
+        const ssize_t n = ::pwrite(_fd, p, n_bytes, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            _set_error("Recording write failed: " + errno_str());
+            return false;
+        }
+        p        += n;
+        offset   += n;
+        n_bytes  -= n;
+    }
+    return true;
+}
+
+void CaptureRecorder::_write_header() {
+    // Goes through the same (possibly O_DIRECT) fd, so pad to whole blocks.
+    auto* buf = static_cast<uint8_t*>(std::aligned_alloc(BLOCK_BYTES, RECORDING_HEADER_BYTES));
+    if (!buf) {
+        _set_error("Failed to allocate the recording header.");
+        return;
+    }
+    std::memset(buf, 0, RECORDING_HEADER_BYTES);
+    std::memcpy(buf, &_header, sizeof(_header));
+    _write_at(buf, RECORDING_HEADER_BYTES, 0);
+    std::free(buf);
+}
+
+void CaptureRecorder::_set_error(const std::string& what) {
+    std::lock_guard<std::mutex> lock(_error_mutex);
+    if (_error.empty()) _error = what;
+}
+
+void CaptureRecorder::close() {
+    if (_closed) return;
+    _closed = true;
+
+    _closing = true;
+    _wake.notify_one();
+    if (_writer.joinable()) _writer.join();
+
+    // Drop the preallocated tail and the final block's padding.
+    const uint64_t n_frames = _frames_written.load();
+    const uint64_t file_end = RECORDING_HEADER_BYTES + n_frames * _header.record_bytes;
+    if (::ftruncate(_fd, static_cast<off_t>(file_end)) != 0) {
+        _set_error("Failed to trim the recording: " + errno_str());
+    }
+
+    _header.n_frames       = n_frames;
+    _header.frames_dropped = _frames_dropped.load();
+    _write_header();
+
+    ::close(_fd);
+    _fd = -1;
+}
+
+RecordingStats CaptureRecorder::stats() const {
+    RecordingStats stats;
+    stats.frames_written   = _frames_written.load();
+    stats.frames_dropped   = _frames_dropped.load();
+    stats.bytes_written    = _bytes_written.load();
+    stats.elapsed_s        = 1e-9 * _last_write_ns.load();
+    stats.throughput_mb_s  = (stats.elapsed_s > 0.0) ? 1e-6 * stats.bytes_written / stats.elapsed_s : 0.0;
+    stats.queue_high_water = _queue_high_water.load();
+    stats.direct_io        = _direct_io;
+
+    std::lock_guard<std::mutex> lock(_error_mutex);
+    stats.error = _error;
+    return stats;
+}
+
+// ---- RecordingReader ------------------------------------------------------
+
+RecordingReader::RecordingReader(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + path + ": " + errno_str());
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(RecordingHeader)) {
+        ::close(fd);
+        throw std::runtime_error(path + " is not a recording.");
+    }
+    _size = st.st_size;
+
+    // Private and writable: views handed out can be scribbled on without
+    // faulting, and nothing reaches the file.
+    void* mem = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        throw std::runtime_error("Failed to map " + path + ": " + errno_str());
+    }
+    _base   = static_cast<uint8_t*>(mem);
+    _header = reinterpret_cast<const RecordingHeader*>(_base);
+
+    const bool valid = (
+        std::memcmp(_header->magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) == 0
+        && _header->version == RECORDING_VERSION
+        && _header->header_bytes <= _size
+        && _header->record_bytes == sizeof(RecordedFrame) + sizeof(uint16_t) * _header->frame_samples
+        && _header->n_channels <= RECORDING_MAX_CHANNELS
+        && _header->n_codes <= RECORDING_MAX_CODES
+    );
+    if (!valid) {
+        ::munmap(mem, _size);
+        throw std::runtime_error(path + " is not a recording this version can read.");
+    }
+
+    const uint64_t n_whole = (_size - _header->header_bytes) / _header->record_bytes;
+    if (_header->n_frames > 0) {
+        _n_frames = std::min(_header->n_frames, n_whole);
+    } else {
+        // Never closed: the preallocated tail reads as zeros, and no written
+        // frame has t0 == 0.
+        while (_n_frames < n_whole && frame(_n_frames).t0 != 0.0) ++_n_frames;
+    }
+
+    ::madvise(mem, _size, MADV_SEQUENTIAL);
+}
+
+RecordingReader::~RecordingReader() {
+    ::munmap(const_cast<uint8_t*>(_base), _size);
+}
+
+void RecordingReader::decode(int ch, uint64_t first, uint64_t count, float* dst) const {
+    if (ch < 0 || ch >= _header->n_channels) {
+        throw std::runtime_error("Channel not in the recording.");
+    }
+    if (first > _n_frames || count > _n_frames - first) {
+        throw std::runtime_error("Frame range out of bounds.");
+    }
+
+    const int n = _header->frame_samples;
+    for (uint64_t i = 0; i < count; ++i) {
+        sample_kernels::decode_field(
+            frame_words(first + i), n, _header->channel_shift[ch], _header->channel_code_mask[ch],
+            _header->code_table, dst + i * n
+        );
+    }
+}
@@ -0,0 +1,186 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "adc.hpp"
+
+// On-disk layout of a recording: a RecordingHeader padded to header_bytes,
+// then back-to-back fixed-size frame records, each a RecordedFrame followed
+// by frame_samples raw 16-bit capture words. Little-endian, as the Pi writes.
+static constexpr char     RECORDING_MAGIC[8]     = {'R', 'P', 'I', 'O', 'S', 'C', 'R', '1'};
+static constexpr uint32_t RECORDING_VERSION      = 1;
+static constexpr size_t   RECORDING_HEADER_BYTES = 8192;
+static constexpr int      RECORDING_MAX_CHANNELS = 32;
+static constexpr int      RECORDING_MAX_CODES    = 1024;
+
+struct RecordingHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_bytes;        // offset of the first frame record
+    double   sample_rate_hz;
+    float    vref_low;
+    float    vref_high;
+    int32_t  bit_format;          // 0 offset binary, 1 two's complement
+    int32_t  code_bits;
+    int32_t  frame_samples;
+    uint32_t record_bytes;        // sizeof(RecordedFrame) + 2 * frame_samples
+    double   start_unix_s;        // wall-clock time the recording started
+    double   start_steady_s;      // the same instant on the clock frame t0s use
+    uint64_t n_frames;            // filled in when the recording is closed
+    uint64_t frames_dropped;
+
+    // Where each channel's code sits in a word, as in ChannelField. Taken
+    // from the first recorded frame.
+    int32_t  n_channels;
+    uint32_t channel_mask;        // bit ch set if channel ch was active
+    int32_t  channel_shift[RECORDING_MAX_CHANNELS];
+    uint32_t channel_code_mask[RECORDING_MAX_CHANNELS];
+
+    // Raw code -> volts, calibration included, for the first n_codes codes.
+    int32_t  n_codes;
+    float    code_table[RECORDING_MAX_CODES];
+};
+static_assert(sizeof(RecordingHeader) <= RECORDING_HEADER_BYTES);
+
+// Precedes each frame's words. index counts every frame offered to the
+// recorder, so a gap in it is a dropped frame.
+struct RecordedFrame {
+    uint64_t index;
+    double   t0;  // capture start, steady-clock seconds
+};
+
+struct RecordingStats {
+    uint64_t    frames_written   = 0;
+    uint64_t    frames_dropped   = 0;  // queue full, file full or wrong size
+    uint64_t    bytes_written    = 0;
+    double      elapsed_s        = 0.0;
+    double      throughput_mb_s  = 0.0;  // bytes_written / elapsed_s, sustained
+    int         queue_high_water = 0;    // most frames ever waiting for the writer
+    bool        direct_io        = false;
+    std::string error;                   // first write error; recording stops at it
+};
+
+/*
+ * Appends captures to a recording file from a writer thread.
+ *
+ * push() copies a capture's words into a ring of queue_frames preallocated
+ * records and returns; it never blocks and never takes a lock, so the worker
+ * can call it every frame. The writer gathers records into a large aligned
+ * staging buffer and writes it out in whole blocks, with O_DIRECT where the
+ * filesystem allows it, so recording does not churn the page cache.
+ */
+class CaptureRecorder {
+public:
+    // Create (or truncate) path and start the writer. The header's frame
+    // layout fields must be set; max_bytes > 0 preallocates and caps the file.
+    CaptureRecorder(
+        const std::string& path, const RecordingHeader& header, uint64_t max_bytes, int queue_frames
+    );
+    ~CaptureRecorder();
+
+    CaptureRecorder(const CaptureRecorder&) = delete;
+    CaptureRecorder& operator=(const CaptureRecorder&) = delete;
+
+    // Queue cap for writing. One producer thread only.
+    void push(const Capture& cap);
+
+    // Write out everything queued, finish the header and close the file.
+    // The producer must be done pushing. Safe to call more than once.
+    void close();
+
+    RecordingStats stats() const;
+
+private:
+    static constexpr size_t STAGING_BYTES = 4 << 20;  // at least; more for huge frames
+    static constexpr size_t BLOCK_BYTES   = 4096;  // O_DIRECT offset/length alignment
+
+    RecordingHeader _header;
+    uint64_t        _max_bytes;
+    int             _fd = -1;
+    bool            _direct_io = false;
+
+    // Record ring: slot i % n_slots holds pushed frame i.
+    int             _n_slots;
+    uint8_t*        _slots = nullptr;
+    std::atomic<uint64_t> _head{0};    // frames pushed, producer-only writes
+    std::atomic<uint64_t> _tail{0};    // frames taken by the writer
+    uint64_t        _next_index = 0;   // producer-only
+    uint64_t        _accepted   = 0;   // producer-only: frames that fit the cap
+    bool            _have_channels = false;  // producer-only until close()
+
+    // Writer side. The staging buffer starts at file offset _file_pos.
+    uint8_t*        _staging = nullptr;
+    size_t          _staging_bytes = 0;
+    size_t          _staged = 0;
+    uint64_t        _file_pos = RECORDING_HEADER_BYTES;
+
+    std::thread             _writer;
+    std::mutex              _wake_mutex;
+    std::condition_variable _wake;
+    std::atomic<bool>       _closing{false};
+    bool                    _closed = false;
+
+    std::chrono::steady_clock::time_point _started;
+    std::atomic<uint64_t> _frames_written{0};
+    std::atomic<uint64_t> _frames_dropped{0};
+    std::atomic<uint64_t> _bytes_written{0};
+    std::atomic<int64_t>  _last_write_ns{0};  // since _started
+    std::atomic<int>      _queue_high_water{0};
+    mutable std::mutex    _error_mutex;
+    std::string           _error;
+
+    void _writer_loop();
+    // Write the staging buffer's whole blocks (all of it, zero-padded, if
+    // final). False after a write error.
+    bool _flush(bool final);
+    bool _write_at(const void* data, size_t n_bytes, uint64_t offset);
+    void _write_header();
+    void _set_error(const std::string& what);
+};
+
+/*
+ * Read-only view of a recording file, memory-mapped whole.
+ */
+class RecordingReader {
+public:
+    explicit RecordingReader(const std::string& path);
+    ~RecordingReader();
+
+    RecordingReader(const RecordingReader&) = delete;
+    RecordingReader& operator=(const RecordingReader&) = delete;
+
+    const RecordingHeader& header() const { return *_header; }
+
+    // Frames in the file: the header's count, or for a recording that was
+    // never closed, every whole record up to the first unwritten one.
+    uint64_t n_frames() const { return _n_frames; }
+
+    const RecordedFrame& frame(uint64_t i) const {
+        return *reinterpret_cast<const RecordedFrame*>(_record(i));
+    }
+    const uint16_t* frame_words(uint64_t i) const {
+        return reinterpret_cast<const uint16_t*>(_record(i) + sizeof(RecordedFrame));
+    }
+
+    // Base of the record array, for strided views of it.
+    const uint8_t* records() const { return _base + _header->header_bytes; }
+
+    // Volts of channel ch over frames [first, first + count), concatenated.
+    void decode(int ch, uint64_t first, uint64_t count, float* dst) const;
+
+private:
+    const uint8_t*         _base = nullptr;
+    size_t                 _size = 0;
+    const RecordingHeader* _header = nullptr;
+    uint64_t               _n_frames = 0;
+
+    const uint8_t* _record(uint64_t i) const {
+        return records() + i * _header->record_bytes;
+    }
+};
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "peripherals/dma/dma.hpp"
+#include "peripherals/dma/dma_channels.hpp"
+
+// Checks DMAChannelRegistry against the real DMA registers: FULL requests
+// never get a Lite channel, and a released channel can be acquired again.
+// Run as root, with nothing else in this process holding channels.
+
+static int n_failed = 0;
+
+static void check(bool ok, const char* what) {
+    std::cerr << (ok ? "ok      " : "FAILED  ") << what << std::endl;
+    n_failed += ok ? 0 : 1;
+}
+
+int main() {
+    DMA dma;
+    auto& registry = DMAChannelRegistry::instance();
+
+    std::cerr << std::hex << "available mask 0x" << registry.available_mask() << std::dec << std::endl;
+
+    // Take every free full channel.
+    std::vector<DMAChannel> full;
+    while (true) {
+        try {
+            full.push_back(registry.acquire(dma, DMAChannelKind::FULL));
+        } catch (const std::runtime_error&) {
+            break;
+        }
+    }
+    std::cerr << full.size() << " full channels free" << std::endl;
+    if (full.empty()) {
+        std::cerr << "Nothing to test without a free full channel." << std::endl;
+        return 1;
+    }
+
+    bool none_lite = true;
+    for (const auto& chan : full) {
+        std::cerr << "  got " << chan.id() << std::endl;
+        none_lite = none_lite && !chan.lite() && chan.id() < 7;
+    }
+    check(none_lite, "FULL never returns channels 7-14");
+
+    bool threw = false;
+    try { registry.acquire(dma, DMAChannelKind::FULL); } catch (const std::runtime_error&) { threw = true; }
+    check(threw, "FULL throws once every full channel is held");
+
+    // Release one by destroying its handle; it is the only full channel
+    // left, so the next FULL request must get it back.
+    const int id = full.back().id();
+    full.pop_back();
+    check(!(registry.claimed_mask() & (1u << id)), "release clears the claimed bit");
+    check(!dma.channel_in_use(id), "release leaves the channel reset and disabled");
+    {
+        DMAChannel again = registry.acquire(dma, DMAChannelKind::FULL);
+        check(again.id() == id, "a released channel is acquired again");
+
+        // Moving a handle moves the claim; the moved-from one releases nothing.
+        DMAChannel moved = std::move(again);
+        check(!again && moved.id() == id, "moving a handle moves the claim");
+        check((registry.claimed_mask() & (1u << id)) != 0, "the moved claim still holds the channel");
+
+        threw = false;
+        try { registry.acquire(dma, id); } catch (const std::runtime_error&) { threw = true; }
+        check(threw, "acquiring a held channel by number throws");
+    }
+    check(!(registry.claimed_mask() & (1u << id)), "scope exit releases the moved handle");
+
+    {
+        DMAChannel by_id = registry.acquire(dma, id);
+        check(by_id.id() == id, "a released channel can be acquired by number");
+    }
+
+    full.clear();
+    check(registry.claimed_mask() == 0, "nothing is claimed once every handle is gone");
+
+    std::cerr << (n_failed ? "FAILED" : "passed") << std::endl;
+    return n_failed ? 1 : 0;
+}
@@ -65,17 +65,11 @@ int main(int argc, char** argv) {
     uint8_t* rx_data_virt = (uint8_t*)(tx_data_virt + 3);
     uint8_t* rx_data_bus = (uint8_t*)(tx_data_bus + 3);
 
-    auto& cb0 = dma.get_cb(0);
-    auto& cb1 = dma.get_cb(1);
-
     auto spi_fifo_bus_addr = (uint32_t)(uintptr_t)spi.reg_to_bus(SPI_FIFO_OFS);
+    DMAChain chain(DMA_LITE_MAX_XFER_LEN);
 
     // Send SPI setup word and initial CS high bits, then switch to loop on CB1 toggling CS.
-    cb0.ti = DMATransferInfo{{.wait_for_writes=1, .dest_dma_req=1, .src_addr_incr=1, .peri_map=DMA_PERI_MAP_SPI_TX}}.bits;
-    cb0.src = (uint32_t)(uintptr_t)tx_data_bus;
-    cb0.dst = spi_fifo_bus_addr;
-    cb0.len = 4 + 4;
-    cb0.next_cb = (uint32_t)(uintptr_t)dma.get_cb_bus_ptr(1);
+    chain.add(dma_ti_mem_to_peri(DMA_PERI_MAP_SPI_TX), (uint32_t)(uintptr_t)tx_data_bus, spi_fifo_bus_addr, 4 + 4);
 
     tx_data_virt[0] = (
         (2 * n_samples) << 16
@@ -85,32 +79,20 @@ int main(int argc, char** argv) {
 
 
     // Toggle CS in a loop. 
-    cb1.ti = DMATransferInfo{{.wait_for_writes=1, .dest_dma_req=1, .src_addr_incr=0, .peri_map=DMA_PERI_MAP_SPI_TX}}.bits;
-    cb1.src = (uint32_t)(uintptr_t)(tx_data_bus + 2);
-    cb1.dst = spi_fifo_bus_addr;
-    cb1.len = 4;
-    cb1.next_cb = (uint32_t)(uintptr_t)dma.get_cb_bus_ptr(1);
+    const int cb1 = chain.add(
+        dma_ti({.wait_for_writes=true, .dest_dma_req=true, .peri_map=DMA_PERI_MAP_SPI_TX}),
+        (uint32_t)(uintptr_t)(tx_data_bus + 2), spi_fifo_bus_addr, 4
+    );
+    chain.link(cb1, cb1);
 
     tx_data_virt[2] = 0b00000001000000000000000100000000;
 
-    uint8_t* cur_rx_ptr = rx_data_bus;
-    int rx_bytes_rem = 2 * n_samples;
-    for(int i=2; i<n_rx_cbs + 2; ++i) {
-        auto& cbi = dma.get_cb(i);
-        cbi.ti = DMATransferInfo{{.wait_for_writes=1, .dest_addr_incr=1, .src_dma_req=1, .peri_map=DMA_PERI_MAP_SPI_RX}}.bits;
-        cbi.src = spi_fifo_bus_addr;
-        cbi.dst = (uint32_t)(uintptr_t)cur_rx_ptr;
-        cbi.len = std::min(rx_block_size, rx_bytes_rem);
-
-        if (i < (n_rx_cbs + 2 - 1)) {
-            cbi.next_cb = (uint32_t)(uintptr_t)dma.get_cb_bus_ptr(i + 1);
-        } else {
-            cbi.next_cb = 0;
-        }
-
-        cur_rx_ptr += rx_block_size;
-        rx_bytes_rem -= rx_block_size;
-    }
+    chain.peri_to_mem(
+        dma_ti_peri_to_mem(DMA_PERI_MAP_SPI_RX), spi_fifo_bus_addr, (uint32_t)(uintptr_t)rx_data_bus,
+        2 * n_samples, rx_block_size
+    );
+    chain.stop(chain.last());
+    dma.load_chain(chain);
 
     /*
     cb0.ti = cb1.ti = cb2.ti = cb3.ti = (uint32_t)(DMATransferInfo::DST_DREQ | DMATransferInfo::PERI_MAP_PWM);
@@ -169,8 +151,6 @@ int main(int argc, char** argv) {
         std::cerr << "len reg post: " << post_len << std::endl;
     }
 
-    // add alignment check for CB ptrs, bottom 5 bits, assert !(cb_addr & 31)
-
     //pwm.enable_dma(/*dreq_thresh=*/1);
     //std::this_thread::sleep_for(std::chrono::microseconds(100));
 
@@ -6,7 +6,16 @@ FrequencyCounter::FrequencyCounter(
     int n_samples,
     int gpio_pin,
     int dma_chan
-) : _gpio_pin(gpio_pin), _n_samples(n_samples), _dma_chan(dma_chan), _dma(/*n_cbs=*/2) {
+) :
+    _gpio_pin(gpio_pin),
+    _n_samples(n_samples),
+    _dma(/*n_cbs=*/2),
+    // The capture is a single CB, too long for a Lite channel past 64 KiB.
+    _dma_chan(dma_chan < 0
+        ? DMAChannelRegistry::instance().acquire(_dma, (n_samples > (int)DMA_LITE_MAX_XFER_LEN)
+            ? DMAChannelKind::FULL : DMAChannelKind::LITE)
+        : DMAChannelRegistry::instance().acquire(_dma, dma_chan))
+{
     if ((n_samples % 8) != 0) {
         throw std::runtime_error(
             "n_samples must be a multiple of the SMI transfer size (1 byte / 8 bits)."
@@ -33,21 +42,36 @@ void FrequencyCounter::_setup_dma_cbs() {
     _data = _mbox.alloc_vc_mem(_n_samples, _asi.page_size);
     auto data_bus = (uint8_t*)_data.bus;
 
-    auto& dma_cb = _dma.get_cb(0);
+    DMAChain chain(_dma_chan.max_xfer_len());
+    chain.add(
+        dma_ti({.dest_addr_incr=true, .src_dma_req=true, .peri_map=DMA_PERI_MAP_SMI}),
+        (uint32_t)(uintptr_t)_smi.reg_to_bus(SMI_DATA_OFS),
+        (uint32_t)(uintptr_t)data_bus,
+        _n_samples
+    );
+    chain.stop(0);
+    _dma.load_chain(chain);
+}
 
-    auto smi_data_bus_addr = (uint32_t)(uintptr_t)_smi.reg_to_bus(SMI_DATA_OFS);
+void FrequencyCounter::set_realtime(int cpu, int fifo_priority, bool lock_memory) {
+    const RealtimeSettings settings{.cpu=cpu, .fifo_priority=fifo_priority, .lock_memory=lock_memory};
+    { ScopedRealtime trial(settings); }
+    _rt_settings = settings;
+}
 
-    dma_cb.ti = DMATransferInfo{{.dest_addr_incr=1, .src_dma_req=1, .peri_map=DMA_PERI_MAP_SMI}}.bits;
-    dma_cb.src = smi_data_bus_addr;
-    dma_cb.dst = (uint32_t)(uintptr_t)data_bus;
-    dma_cb.len = _n_samples;
-    dma_cb.next_cb = 0;
+RealtimeStatus FrequencyCounter::realtime_status() const {
+    std::optional<ScopedRealtime> rt;
+    if (_rt_settings) rt.emplace(*_rt_settings);
+    return ::realtime_status(pthread_self());
 }
 
 float FrequencyCounter::sample() {
+    std::optional<ScopedRealtime> rt;
+    if (_rt_settings) rt.emplace(*_rt_settings);
+
     _smi.start_xfer(_n_samples, /*packed=*/true);
-    _dma.start(_dma_chan, /*first_cb_idx=*/0);
-    _dma.wait(_dma_chan);
+    _dma.start(_dma_chan.id(), /*first_cb_idx=*/0);
+    _dma.wait(_dma_chan.id());
     _smi.stop_xfer();
 
     auto data_virt = (uint8_t*)_data.virt;
@@ -1,10 +1,12 @@
 #pragma once
 #include <cstdint>
+#include <optional>
 
 #include "peripherals/dma/dma.hpp"
 #include "peripherals/gpio/gpio.hpp"
 #include "peripherals/mailbox/mailbox.hpp"
 #include "peripherals/smi/smi.hpp"
+#include "utils/realtime.hpp"
 #include "utils/reg_mem_utils.hpp"
 #include "utils/rpi_zero_2.hpp"
 
@@ -14,19 +16,28 @@ class FrequencyCounter {
             int tgt_sample_rate=50'000'000,
             int n_samples=16384,
             int gpio_pin=8,
-            int dma_chan=10
+            int dma_chan=-1  // -1 for any free channel
         );
         virtual ~FrequencyCounter();
 
         float sample();
 
+        // sample() runs on the calling thread, so these apply to whichever
+        // thread calls it, for the duration of each call (see ADC's
+        // set_realtime()). Tried once here so a refusal throws straight away.
+        void set_realtime(int cpu = 3, int fifo_priority = 80, bool lock_memory = true);
+        void clear_realtime() { _rt_settings.reset(); }
+
+        // What the calling thread gets while sampling.
+        RealtimeStatus realtime_status() const;
+
     protected:
         void _setup_dma_cbs();
 
         int _gpio_pin;
         int _n_samples;
-        int _dma_chan;
         int _smi_clock_speed;
+        std::optional<RealtimeSettings> _rt_settings;
 
         MemPtrs _data;
 
@@ -35,4 +46,5 @@ class FrequencyCounter {
         DMA _dma;
         SMI _smi;
         GPIO _gpio;
+        DMAChannel _dma_chan;
 };
@@ -0,0 +1,118 @@
+#include <algorithm>
+
+#include "minmax_pyramid.hpp"
+#include "sample_kernels.hpp"
+
+static void merge(MinMaxPyramid::Stats& acc, float min_val, float max_val, double sum, int count) {
+    if (acc.count == 0) {
+        acc.min = min_val;
+        acc.max = max_val;
+    } else {
+        acc.min = std::min(acc.min, min_val);
+        acc.max = std::max(acc.max, max_val);
+    }
+    acc.sum   += sum;
+    acc.count += count;
+}
+
+void MinMaxPyramid::build(
+    const uint16_t* words, int n_samples, int shift, uint32_t mask, const float* table,
+    uint64_t table_version
+) {
+    _n_samples = n_samples;
+    _shift = shift;
+    _mask = mask;
+    _table_version = table_version;
+
+    const int n_blocks = n_samples >> BLOCK_SHIFT;
+    int n_levels = 0;
+    for (int n = n_blocks; n > 0; n >>= 1) {
+        ++n_levels;
+    }
+    _levels.resize(n_levels);
+
+    if (n_levels == 0) return;
+
+    auto& base = _levels[0];
+    base.resize(n_blocks);
+    float vals[BLOCK_SIZE];
+    for (int b = 0; b < n_blocks; ++b) {
+        sample_kernels::decode_field(words + b * BLOCK_SIZE, BLOCK_SIZE, shift, mask, table, vals);
+        // A block is short enough to sum in float without losing precision.
+        float sum;
+        sample_kernels::minmax_sum_f32(vals, BLOCK_SIZE, &base[b].min, &base[b].max, &sum);
+        base[b].sum = sum;
+    }
+
+    for (int k = 1; k < n_levels; ++k) {
+        const auto& below = _levels[k - 1];
+        auto& level = _levels[k];
+        level.resize(n_blocks >> k);
+        for (size_t i = 0; i < level.size(); ++i) {
+            const Node& a = below[2 * i + 0];
+            const Node& b = below[2 * i + 1];
+            level[i] = {std::min(a.min, b.min), std::max(a.max, b.max), a.sum + b.sum};
+        }
+    }
+}
+
+MinMaxPyramid::Stats MinMaxPyramid::query(
+    const uint16_t* words, const float* table, int begin, int end
+) const {
+    Stats acc;
+    begin = std::max(begin, 0);
+    end   = std::min(end, _n_samples);
+    if (begin >= end) return acc;
+
+    // Whole level-0 blocks inside [begin, end).
+    const int first_block = (begin + BLOCK_SIZE - 1) >> BLOCK_SHIFT;
+    const int end_block   = end >> BLOCK_SHIFT;
+    if (first_block >= end_block) {
+        _scan(words, table, begin, end, acc);
+        return acc;
+    }
+
+    _scan(words, table, begin, first_block << BLOCK_SHIFT, acc);
+
+    // Greedily take the highest-level node that starts at i and still fits.
+    int i = first_block;
+    while (i < end_block) {
+        int k = 0;
+        while (k + 1 < n_levels()
+               && (i & ((2 << k) - 1)) == 0
+               && i + (2 << k) <= end_block) {
+            ++k;
+        }
+
+        const Node& node = _levels[k][i >> k];
+        merge(acc, node.min, node.max, node.sum, BLOCK_SIZE << k);
+        i += 1 << k;
+    }
+
+    _scan(words, table, end_block << BLOCK_SHIFT, end, acc);
+    return acc;
+}
+
+void MinMaxPyramid::clear() {
+    _n_samples = 0;
+    _table_version = 0;
+    _levels.clear();
+}
+
+void MinMaxPyramid::_scan(
+    const uint16_t* words, const float* table, int begin, int end, Stats& acc
+) const {
+    // Edges are shorter than a block, so a plain loop beats the SIMD kernels.
+    if (begin >= end) return;
+
+    float min_val = table[(words[begin] >> _shift) & _mask];
+    float max_val = min_val;
+    double sum = 0.0;
+    for (int i = begin; i < end; ++i) {
+        const float v = table[(words[i] >> _shift) & _mask];
+        min_val = std::min(min_val, v);
+        max_val = std::max(max_val, v);
+        sum += v;
+    }
+    merge(acc, min_val, max_val, sum, end - begin);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Min/max/sum pyramid over one channel of a capture, so any sample range can
+// be reduced without walking every sample in it.
+//
+// Level 0 summarizes blocks of BLOCK_SIZE samples and each level above it
+// halves the number of blocks. A range query takes the largest aligned
+// blocks that fit inside it, and decodes the (at most 2 * BLOCK_SIZE)
+// samples at its unaligned edges straight from the raw codes, so results
+// are exact: min/max match a linear scan bit-for-bit, and sum only differs
+// by float rounding order.
+//
+// Values come from the same code words and conversion table as
+// get_buffers(), so the pyramid never holds a copy of the samples.
+class MinMaxPyramid {
+public:
+    static constexpr int BLOCK_SHIFT = 4;
+    static constexpr int BLOCK_SIZE  = 1 << BLOCK_SHIFT;
+
+    struct Node {
+        float  min;
+        float  max;
+        double sum;
+    };
+
+    // Reduction of one sample range. count == 0 for an empty range.
+    struct Stats {
+        float  min   = 0.0f;
+        float  max   = 0.0f;
+        double sum   = 0.0;
+        int    count = 0;
+    };
+
+    // Summarize the channel at (words[i] >> shift) & mask, in volts through
+    // table. Reuses the level storage when n_samples does not change.
+    // table_version is only recorded, for callers to tell which table the
+    // nodes came from.
+    void build(
+        const uint16_t* words, int n_samples, int shift, uint32_t mask, const float* table,
+        uint64_t table_version = 0
+    );
+
+    // Reduce samples [begin, end). words and table must be the ones passed to
+    // build().
+    Stats query(const uint16_t* words, const float* table, int begin, int end) const;
+
+    void clear();
+
+    int n_samples() const { return _n_samples; }
+    int n_levels() const { return static_cast<int>(_levels.size()); }
+    uint64_t table_version() const { return _table_version; }
+
+private:
+    int      _n_samples = 0;
+    int      _shift = 0;
+    uint32_t _mask = 0;
+    uint64_t _table_version = 0;
+
+    // _levels[k][i] covers samples [i << (BLOCK_SHIFT + k), (i + 1) << (BLOCK_SHIFT + k)).
+    std::vector<std::vector<Node>> _levels;
+
+    void _scan(const uint16_t* words, const float* table, int begin, int end, Stats& acc) const;
+};
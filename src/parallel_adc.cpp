@@ -1,8 +1,11 @@
+#include <chrono>
 #include <cmath>
+#include <limits>
 #include <tuple>
 #include <utility>
 
 #include "parallel_adc.hpp"
+#include "sample_kernels.hpp"
 #include "peripherals/dma/dma_defs.hpp"
 #include "peripherals/gpio/gpio_defs.hpp"
 #include "peripherals/pwm/pwm_defs.hpp"
@@ -73,6 +76,7 @@ ParallelADC::ParallelADC(std::pair<float, float> vref, int n_samples, int n_chan
     _gpio.set_mode(22, GPIOMode::ALT_1);
     _gpio.set_mode(23, GPIOMode::ALT_1);
 
+    _rebuild_code_table();
     resize(n_samples);
 }
 
@@ -83,9 +87,14 @@ ParallelADC::~ParallelADC() {
 }
 
 void ParallelADC::resize(int n_samples) {
+    if (_continuous && (n_samples % 2) != 0) {
+        throw std::runtime_error("Continuous mode needs an even n_samples.");
+    }
+
+    const ScopedTiming timing(_reconfig_time);
     _stop_worker();
 
-    if (_front_bufs.ndim() == 3 && _front_bufs.shape(1) == n_samples) {
+    if (static_cast<int>(_frames.write_slot()->words.size()) == n_samples) {
         _n_samples = n_samples;
         return;
     }
@@ -97,23 +106,28 @@ void ParallelADC::resize(int n_samples) {
         return;
     }
 
+    _alloc_rx_buf();
+    _resize_captures(_n_channels, _n_samples);
+
+    _setup_dma_cbs();
+}
+
+// Ring segments start on a 64-byte boundary so the unpack kernels' loads from
+// uncached memory stay aligned in every slot.
+static int segment_stride(int n_samples) {
+    return (n_samples * static_cast<int>(sizeof(uint16_t)) + 63) & ~63;
+}
+
+void ParallelADC::_alloc_rx_buf() {
     // Allocate enough for the worst-case transfer size (16-bit / dual-channel).
     // _setup_dma_cbs() computes the exact byte count based on current mode.
-    const int alloc_bytes = n_samples * sizeof(uint16_t);
+    const int alloc_bytes = _n_ring_segments * segment_stride(_n_samples);
     if (_data.vc_handle) _dma._mbox.free_vc_mem(_data);
     _data = _dma._mbox.alloc_vc_mem(alloc_bytes, _asi.page_size);
     _rx_data_virt = (uint16_t*)_data.virt;
     _rx_data_bus  = (uint16_t*)_data.bus;
-
-    _resize_flat_bufs(_n_channels, _n_samples);
-
-    _setup_dma_cbs();
 }
 
-// Maximum bytes transferred per DMA CB (must fit in the 16-bit len field,
-// and must be an even number so 8-bit packed pairs stay aligned).
-static constexpr int DMA_MAX_CB_BYTES = 65534;
-
 void ParallelADC::_setup_dma_cbs() {
     // LA mode is handled entirely by _setup_la_dma_cbs() in the base class.
     // This function only handles the SMI path.
@@ -127,44 +141,36 @@ void ParallelADC::_setup_dma_cbs() {
     // so we must transfer an even number of bytes total.
     if (use_8bit) bytes_to_xfer += (bytes_to_xfer % 2);
 
-    const int n_cbs = (bytes_to_xfer + DMA_MAX_CB_BYTES - 1) / DMA_MAX_CB_BYTES;
-    _dma.resize_cbs(n_cbs);
-
-    // Distribute bytes evenly across all CBs so no CB is tiny. A tiny last CB
-    // misses SMI DREQ: by the time the DMA loads it, the SMI transfer count has
-    // reached 0 and DREQ is deasserted. Rounding up to even keeps 16-bit pairs
-    // aligned across CB boundaries.
-    const int max_chunk_size = ((bytes_to_xfer + n_cbs - 1) / n_cbs + 1) & ~1;
+    // The chain is repeated once per receive segment. Continuous mode links
+    // each segment's chain into the next and the last back to the first, so
+    // the DMA never stops.
+    _seg_stride = segment_stride(_n_samples);
 
+    // Bytes are spread evenly across each segment's CBs (see
+    // DMAChain::peri_to_mem()), in even chunks so 16-bit pairs stay aligned
+    // across CB boundaries.
+    static constexpr uint32_t ti = dma_ti({.dest_addr_incr=true, .src_dma_req=true, .peri_map=DMA_PERI_MAP_SMI});
     const auto smi_data_bus_addr = (uint32_t)(uintptr_t)_smi.reg_to_bus(SMI_DATA_OFS);
-    const uint32_t ti = DMATransferInfo{{.dest_addr_incr=1, .src_dma_req=1, .peri_map=DMA_PERI_MAP_SMI}}.bits;
-
-    int remaining = bytes_to_xfer;
-    uint8_t* dst_bus = (uint8_t*)_rx_data_bus;
-    for (int i = 0; i < n_cbs; ++i) {
-        auto& cb  = _dma.get_cb(i);
-        const int chunk_size = std::min(max_chunk_size, remaining);
-
-        cb.ti      = ti;
-        cb.src     = smi_data_bus_addr;
-        cb.dst     = (uint32_t)(uintptr_t)dst_bus;
-        cb.len     = chunk_size;
-        cb.next_cb = (
-            (i < n_cbs - 1) ?
-            (uint32_t)(uintptr_t)_dma.get_cb_bus_ptr(i + 1)
-            : 0
-        );
 
-        dst_bus     += chunk_size;
-        remaining   -= chunk_size;
+    DMAChain chain(DMA_LITE_MAX_XFER_LEN);
+    for (int seg = 0; seg < _n_ring_segments; ++seg) {
+        const auto dst_bus = (uint32_t)(uintptr_t)((uint8_t*)_rx_data_bus + seg * _seg_stride);
+        chain.peri_to_mem(ti, smi_data_bus_addr, dst_bus, bytes_to_xfer, SMI_DMA_MAX_CB_BYTES, /*align=*/2);
+        if (seg == 0) _n_cbs_per_seg = (int)chain.size();
+        if (!_continuous) {
+            chain.stop(chain.last());
+            if (_dma_irq_fd >= 0) chain.interrupt(chain.last());
+        }
     }
+    if (_continuous) chain.link(chain.last(), 0);
+    _dma.load_chain(chain);
 }
 
 uint32_t ParallelADC::start_sampling(uint32_t sample_rate_hz) {
     if (_logic_analyzer_mode) {
-        _cur_real_sample_rate = sample_rate_hz;
-        _la_start_sampling(sample_rate_hz);
-        return sample_rate_hz;
+        _cur_real_sample_rate = _la_setup_sampling(sample_rate_hz);
+        _start_worker(_cur_real_sample_rate);
+        return _cur_real_sample_rate;
     }
 
     if (_cur_real_sample_rate != sample_rate_hz) {
@@ -199,6 +205,7 @@ void ParallelADC::toggle_channel(int channel_idx) {
     const auto highest_pre = _highest_active_channel();
 
     _active_channels[channel_idx] = !_active_channels[channel_idx];
+    _invalidate_buffers_cache();
 
     SMIWidth width = (_highest_active_channel() < 1) ? SMIWidth::_8_BITS : SMIWidth::_16_BITS;
     _smi.setup_device_settings(width, /*device_id=*/0, /*use_dma=*/true);
@@ -225,60 +232,139 @@ void ParallelADC::set_attenuation(int channel, bool att_on) {
     if (att_on) { _gpio.clear_pin(pin); } else { _gpio.set_pin(pin); }
 }
 
-float ParallelADC::_sample_to_float(uint8_t raw_sample) const {
-    const float sample_0_1 = (_bit_format == 0) ?
-        ((float)raw_sample / 255.f) :
-        (0.5f + 0.5f * (float)std::bit_cast<int8_t>(raw_sample) / 128.f);
+void ParallelADC::set_bit_format(int bit_format) {
+    if (bit_format != 0 && bit_format != 1) {
+        throw std::runtime_error("bit_format must be 0 (offset binary) or 1 (2's complement).");
+    }
+
+    const bool was_running = _running.load();
+    if (was_running) _stop_worker();
+
+    _bit_format = bit_format;
+    _rebuild_code_table();
+
+    if (was_running) _start_worker(_cur_real_sample_rate);
+}
+
+void ParallelADC::set_continuous(bool enable, int n_segments) {
+    // One segment being written, one being read, and at least one of slack.
+    if (enable && n_segments < 3) {
+        throw std::runtime_error("Continuous mode needs at least 3 ring segments.");
+    }
+    if (enable && (_n_samples % 2) != 0) {
+        // Segments must hold whole 8-bit packed pairs to sit back to back.
+        throw std::runtime_error("Continuous mode needs an even n_samples.");
+    }
+
+    const bool was_running = _running.load();
+    if (was_running) _stop_worker();
+
+    _continuous = enable;
+    _n_ring_segments = enable ? n_segments : 2;
+    if (!enable) _pretrigger = false;
+
+    // LA mode owns the DMA; _on_la_mode_exit() rebuilds the ring on the way out.
+    if (!_logic_analyzer_mode) {
+        _alloc_rx_buf();
+        _setup_dma_cbs();
+    }
+
+    if (was_running) _start_worker(_cur_real_sample_rate);
+}
+
+void ParallelADC::set_pretrigger(bool enable, float pre_fraction) {
+    if (pre_fraction < 0.0f || pre_fraction > 1.0f) {
+        throw std::runtime_error("pre_fraction must be between 0 and 1.");
+    }
+
+    if (enable && !_continuous) set_continuous(true);
+
+    const bool was_running = _running.load();
+    if (was_running) _stop_worker();
+
+    _pretrigger = enable;
+    _pretrigger_fraction = pre_fraction;
+
+    if (was_running) _start_worker(_cur_real_sample_rate);
+}
+
+float ParallelADC::_code_to_float(uint32_t code) const {
+    return sample_kernels::u8_to_float(code, static_cast<SampleFormat>(_bit_format), _VREF);
+}
 
-    return _VREF.first + (_VREF.second - _VREF.first) * sample_0_1;
+static double steady_now_s() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 void ParallelADC::_start_fetch() {
     if (_logic_analyzer_mode) {
         _start_la_fetch();
+    } else if (_continuous) {
+        if (!_stream_running) _start_stream();
     } else {
         _smi.start_xfer(_n_samples, /*packed=*/true);
-        _dma.start(_dma_chan_0, /*first_cb_idx=*/0);
+        _dma.start(_dma_chan.id(), /*first_cb_idx=*/_rx_fill * _n_cbs_per_seg);
     }
 }
 
-void ParallelADC::_finish_fetch(float* target) {
+bool ParallelADC::_wait_fetch() {
+    if (_logic_analyzer_mode) return _wait_la_fetch();
+    if (_pretrigger) return _wait_pretrigger();
+    if (_continuous) return _wait_stream_segment();
+
+    const auto status = _wait_dma(
+        _dma_chan.id(), _fetch_started, static_cast<double>(_n_samples) / _cur_real_sample_rate
+    );
+    _smi.stop_xfer();
+    if (!status.ok()) {
+        _dma.reset(_dma_chan.id());
+        return false;
+    }
+
+    _rx_ready = _rx_fill;
+    _rx_fill ^= 1;
+    return true;
+}
+
+void ParallelADC::_finish_fetch(Capture& target) {
     if (_logic_analyzer_mode) {
         _finish_la_fetch(target);
         return;
     }
 
-    // Break up the wait into chunks to balance sleeping vs. finishing on time.
-    _dma.wait(
-        _dma_chan_0,
-        16,
-        std::max(1000000 * _n_samples / (8 * _cur_real_sample_rate), 1u)
-    );
-    _smi.stop_xfer();
+    if (_pretrigger) {
+        _finish_pretrigger(target);
+        return;
+    }
+
+    if (_continuous) {
+        _finish_stream_segment(target);
+        return;
+    }
 
+    _unpack_rx((const uint16_t*)((const uint8_t*)_rx_data_virt + _rx_ready * _seg_stride), target);
+}
+
+void ParallelADC::_unpack_rx(const uint16_t* rx, Capture& target) const {
     // If only the first channel is active, each uint16_t contains two packed
-    // samples, swapped because of SMI XRGB packing (see SMI doc PDF).
+    // samples, swapped because of SMI XRGB packing (see SMI doc PDF). Otherwise
+    // each uint16_t already holds one sample per channel, channel N in byte N.
     if (_highest_active_channel() == 0) {
-        for (int i = 0; i < (_n_samples + 1) / 2; ++i) {
-            target[0 * _n_samples * 2 + (2*i+0) * 2 + 0] =
-                _sample_to_float((_rx_data_virt[i] >> 8) & 0xff);
-            target[0 * _n_samples * 2 + (2*i+0) * 2 + 1] = static_cast<float>(2*i+0);
-
-            if ((2*i+1) < _n_samples) {
-                target[0 * _n_samples * 2 + (2*i+1) * 2 + 0] =
-                    _sample_to_float((_rx_data_virt[i] >> 0) & 0xff);
-                target[0 * _n_samples * 2 + (2*i+1) * 2 + 1] = static_cast<float>(2*i+1);
-            }
+        sample_kernels::unpack_packed_u8(rx, _n_samples, target.words.data());
+    } else {
+        sample_kernels::copy_words(rx, _n_samples, target.words.data());
+    }
+    _set_channel_fields(target);
+}
+
+void ParallelADC::_set_channel_fields(Capture& target) const {
+    if (_highest_active_channel() == 0) {
+        for (int ch = 0; ch < _n_channels; ++ch) {
+            target.channels[ch] = {.active=(ch == 0), .shift=0, .mask=0xff};
         }
     } else {
-        for (int i = 0; i < _n_samples; ++i) {
-            for (int ch = 0; ch < _n_channels; ++ch) {
-                if (!_active_channels[ch]) continue;
-                const uint32_t shift = 8 * ch;
-                target[ch * _n_samples * 2 + i * 2 + 0] =
-                    _sample_to_float((_rx_data_virt[i] >> shift) & 0xff);
-                target[ch * _n_samples * 2 + i * 2 + 1] = static_cast<float>(i);
-            }
+        for (int ch = 0; ch < _n_channels; ++ch) {
+            target.channels[ch] = {.active=_active_channels[ch], .shift=8 * ch, .mask=0xff};
         }
     }
 }
@@ -289,17 +375,421 @@ void ParallelADC::_abort_fetch() {
         return;
     }
 
+    _stop_stream();
+}
+
+// ---- Continuous mode ----------------------------------------------------
+
+// The SMI transfer count for a stream. It is good for at least 2^31 - 1
+// samples (about 34 s at 62.5 MS/s), and it can't be topped up while the
+// transfer runs.
+static constexpr int64_t SMI_STREAM_LEN = std::numeric_limits<int>::max();
+
+void ParallelADC::_start_stream() {
+    // The SMI counts down from SMI_STREAM_LEN. The consumers restart the
+    // stream a couple of rings before it runs out (see _stream_near_end()),
+    // which costs a gap of a few segments instead of waiting out a stall.
+    _stream_next = 0;
+    _reset_scan();
+
+    // _stream_write_pos() counts ring wraps from the time since it last
+    // looked, starting here, so the start has to be timed tightly: retry if
+    // something got in between.
+    const uint64_t max_skew_ticks = _stream_max_skew_ticks();
+    while (true) {
+        _stream_t0 = steady_now_s();
+        _stream_t0_ticks = read_cntvct_el0();
+        _smi.start_xfer(static_cast<int>(SMI_STREAM_LEN), /*packed=*/true);
+        _dma.start(_dma_chan.id(), /*first_cb_idx=*/0);
+        if (read_cntvct_el0() - _stream_t0_ticks <= max_skew_ticks) break;
+        _smi.stop_xfer();
+        _dma.reset(_dma_chan.id());
+    }
+    _stream_seen_pos = 0;
+    _stream_seen_ticks = _stream_t0_ticks;
+    _stream_running = true;
+}
+
+void ParallelADC::_stop_stream() {
     _smi.stop_xfer();
-    _dma.reset(_dma_chan_0);
+    _dma.reset(_dma_chan.id());
+    _stream_running = false;
+}
+
+void ParallelADC::_restart_stream() {
+    _stop_stream();
+    _start_stream();
+    ++_acq_stream_restarts;
+}
+
+bool ParallelADC::_stream_near_end() const {
+    return _stream_seen_pos >= SMI_STREAM_LEN - 2 * int64_t(_n_samples) * _n_ring_segments;
+}
+
+uint64_t ParallelADC::_stream_max_skew_ticks() const {
+    // An eighth of a ring period leaves plenty of margin on the half ring
+    // _stream_write_pos() can tell apart.
+    const double ring_s = static_cast<double>(_n_samples) * _n_ring_segments / _cur_real_sample_rate;
+    return static_cast<uint64_t>(ring_s / 8 * static_cast<double>(read_cntfrq_el0()));
+}
+
+int64_t ParallelADC::_stream_write_pos() const {
+    // The DMA destination register says where in the ring it is writing but
+    // not how many times the ring has wrapped. Count wraps from the last
+    // position seen: the samples due since then, from the time elapsed, pick
+    // the advance that lands where the DMA reports. That is right as long as
+    // the estimate is within half a ring, so the clock is the hardware
+    // counter (it runs off the same crystal as the SMI clock and is never
+    // slewed), and the register read is bracketed by two clock reads: if
+    // something got in between, the read is rejected and retried.
+    const int64_t n = _n_samples;
+    const int64_t ring = n * _n_ring_segments;
+    const uint64_t max_skew_ticks = _stream_max_skew_ticks();
+
+    uint64_t before = 0;
+    uint32_t dst = 0;
+    for (int attempt = 0;; ++attempt) {
+        before = read_cntvct_el0();
+        dst = *_dma._dst_regs[_dma_chan.id()];
+        if (read_cntvct_el0() - before <= max_skew_ticks) break;
+        // Still preempted after several tries: report no progress this time.
+        if (attempt == 8) return _stream_seen_pos & ~int64_t(1);
+    }
+
+    const int64_t dst_ofs = static_cast<int64_t>(dst) - static_cast<int64_t>((uintptr_t)_rx_data_bus);
+    const int64_t slot = std::clamp<int64_t>(dst_ofs / _seg_stride, 0, _n_ring_segments - 1);
+    const int64_t bytes_per_sample = (_highest_active_channel() == 0) ? 1 : 2;
+    const int64_t in_slot = std::clamp<int64_t>((dst_ofs - slot * _seg_stride) / bytes_per_sample, 0, n);
+    const int64_t ring_pos = (slot * n + in_slot) % ring;
+
+    // The smallest advance consistent with the register, then whole rings
+    // until it is nearest the estimate.
+    int64_t advance = (ring_pos - _stream_seen_pos % ring) % ring;
+    if (advance < 0) advance += ring;
+    if (advance == 0) return _stream_seen_pos & ~int64_t(1);  // no progress (or a stall)
+
+    const double ticks_per_sample = static_cast<double>(read_cntfrq_el0()) / _cur_real_sample_rate;
+    const double expected = static_cast<double>(before - _stream_seen_ticks) / ticks_per_sample;
+    const int64_t wraps = std::llround((expected - static_cast<double>(advance)) / static_cast<double>(ring));
+    advance += std::max<int64_t>(wraps, 0) * ring;
+
+    _stream_seen_pos += advance;
+    _stream_seen_ticks = before;
+    return _stream_seen_pos & ~int64_t(1);
+}
+
+void ParallelADC::_copy_stream(int64_t begin, int count, uint16_t* dst) const {
+    const int64_t n = _n_samples;
+    const bool packed = (_highest_active_channel() == 0);
+    while (count > 0) {
+        const int64_t slot = (begin / n) % _n_ring_segments;
+        const int off = static_cast<int>(begin % n);
+        const int cnt = static_cast<int>(std::min<int64_t>(count, n - off));
+        const auto* seg = (const uint8_t*)_rx_data_virt + slot * _seg_stride;
+        if (packed) {
+            sample_kernels::unpack_packed_u8((const uint16_t*)(seg + off), cnt, dst);
+        } else {
+            sample_kernels::copy_words((const uint16_t*)seg + off, cnt, dst);
+        }
+        begin += cnt;
+        count -= cnt;
+        dst   += cnt;
+    }
+}
+
+double ParallelADC::_fetch_lead_time_s(double rate_hz, double elapsed_s) const {
+    if (_logic_analyzer_mode || !_continuous || _pretrigger || !_stream_running) {
+        return ADC::_fetch_lead_time_s(rate_hz, elapsed_s);
+    }
+
+    // Don't sleep while completed segments are waiting, or a backlog could
+    // never drain.
+    if (_stream_write_segment() > _stream_next) return 0.0;
+
+    const double seg_s = static_cast<double>(_n_samples) / rate_hz;
+    const double done_at_s = _stream_t0 + static_cast<double>(_stream_next + 1) * seg_s;
+    return std::max(done_at_s - steady_now_s(), 0.0);
+}
+
+bool ParallelADC::_wait_stream_segment() {
+    const int64_t n_slots = _n_ring_segments;
+    const double seg_s = static_cast<double>(_n_samples) / _cur_real_sample_rate;
+    double deadline_s = steady_now_s() + 2.0 * seg_s + 0.1;
+
+    while (_running) {
+        const int64_t writing = _stream_write_segment();
+
+        // Restart before the SMI count runs out, or when there is no
+        // progress (the DMA stalled). The gap shows up as dead time on the
+        // next capture.
+        const bool stalled = (writing <= _stream_next) && steady_now_s() > deadline_s;
+        if (_stream_near_end() || stalled) {
+            _restart_stream();
+            deadline_s = steady_now_s() + 2.0 * seg_s + 0.1;
+            continue;
+        }
+
+        if (writing > _stream_next) break;
+        std::this_thread::sleep_for(std::chrono::duration<double>(std::min(seg_s / 8, 0.005)));
+    }
+
+    // The DMA has wrapped onto (or past) the oldest unread segment. Skip to
+    // the newest complete one; everything in between is lost.
+    const int64_t writing = _stream_write_segment();
+    if (writing - _stream_next >= n_slots) {
+        _acq_overruns += static_cast<uint64_t>(writing - 1 - _stream_next);
+        _stream_next = writing - 1;
+    }
+    _stream_ready = _stream_next++;
+    return true;
+}
+
+void ParallelADC::_finish_stream_segment(Capture& target) {
+    const int64_t n_slots = _n_ring_segments;
+    const double seg_s = static_cast<double>(_n_samples) / _cur_real_sample_rate;
+
+    while (true) {
+        const auto* rx = (const uint16_t*)(
+            (const uint8_t*)_rx_data_virt + (_stream_ready % n_slots) * _seg_stride
+        );
+        _unpack_rx(rx, target);
+
+        // If the DMA came back around to this slot during the copy, it is
+        // torn. The newest complete segment is safe to read right away.
+        const int64_t writing = _stream_write_segment();
+        if (writing - _stream_ready < n_slots) break;
+
+        _acq_overruns += static_cast<uint64_t>(writing - _stream_ready - 1);
+        _stream_ready = writing - 1;
+        _stream_next  = writing;
+    }
+
+    target.t0 = _stream_t0 + static_cast<double>(_stream_ready) * seg_s;
+}
+
+// ---- Pre-trigger mode -----------------------------------------------------
+
+// Samples decoded per trigger-scan step: small enough that a trigger is seen
+// soon after it arrives, large enough to keep the SIMD search busy.
+static constexpr int SCAN_CHUNK = 1024;
+
+void ParallelADC::_reset_scan() {
+    _scan_pos      = 0;
+    _scan_origin   = 0;
+    _scan_armed_at = -1;
+    _scan_count    = 0;
+    _scan_sum      = 0.0;
+    _frame_end_pos = -1;
+    _scan_words.resize(SCAN_CHUNK);
+    _scan_vals.resize(SCAN_CHUNK);
+}
+
+bool ParallelADC::_wait_pretrigger() {
+    const int64_t pre = static_cast<int64_t>(_pretrigger_fraction * _n_samples) & ~int64_t(1);
+    return _scan_frame(
+        _n_samples, pre, trigger_settings(), _running, std::numeric_limits<double>::infinity()
+    );
+}
+
+bool ParallelADC::_scan_frame(
+    int64_t frame_len, int64_t pre, const TriggerSettings& trig,
+    const std::atomic<bool>& keep_going, double deadline_s
+) {
+    const int64_t n = _n_samples;
+    const int64_t ring = n * _n_ring_segments;
+    const double rate = _cur_real_sample_rate;
+    const double poll_s = std::min(SCAN_CHUNK / rate, 0.001);
+    const bool rising = (trig.mode == TrigMode::RISING_EDGE);
+
+    auto [low, high] = trig.thresh;
+    if (trig.auto_range && _auto_thresh) std::tie(low, high) = *_auto_thresh;
+
+    // AUTO sweep hands over an untriggered frame after a frame's worth of
+    // samples without a trigger.
+    const int64_t give_up_at = _scan_pos + frame_len;
+
+    std::optional<int64_t> trig_pos;
+    int64_t last_written = -1;
+    double stall_deadline_s = steady_now_s() + 2.0 * n / rate + 0.1;
+    while (keep_going) {
+        const int64_t written = _stream_write_pos();
+
+        // The SMI count is about to run out; see _wait_stream_segment().
+        if (_stream_near_end()) {
+            _restart_stream();
+            return false;
+        }
+
+        // The unscanned data is about to be overwritten: resume at live data.
+        if (written - _scan_pos > ring - n) {
+            _acq_overruns += static_cast<uint64_t>((written - _scan_pos + n - 1) / n);
+            _scan_pos = written;
+            _scan_armed_at = -1;
+        }
+
+        if (trig.mode == TrigMode::NONE) {
+            // Free-running: back-to-back frames.
+            if (written >= _scan_pos + frame_len) {
+                _frame_start = _scan_pos;
+                break;
+            }
+        } else if (written > _scan_pos) {
+            const int cnt = static_cast<int>(std::min<int64_t>(written - _scan_pos, SCAN_CHUNK));
+            if (_scan_armed_at < 0) _scan_origin = _scan_pos;
+
+            _copy_stream(_scan_pos, cnt, _scan_words.data());
+            sample_kernels::decode_field(
+                _scan_words.data(), cnt, 0, 0xff, _codes->volts.data(), _scan_vals.data()
+            );
+
+            float min_val, max_val, sum;
+            sample_kernels::minmax_sum_f32(_scan_vals.data(), cnt, &min_val, &max_val, &sum);
+            _scan_min = (_scan_count > 0) ? std::min(_scan_min, min_val) : min_val;
+            _scan_max = (_scan_count > 0) ? std::max(_scan_max, max_val) : max_val;
+            _scan_sum   += sum;
+            _scan_count += cnt;
+
+            const int fired = sample_kernels::find_edge(
+                _scan_vals.data(), cnt, low, high, rising,
+                static_cast<int>(_scan_pos - _scan_origin), &_scan_armed_at
+            );
+            _scan_pos += cnt;
+            if (fired >= 0) {
+                trig_pos = _scan_origin + _scan_armed_at;
+                break;
+            }
+            continue;  // scan as fast as the data allows
+        } else if (trig.sweep == TrigSweep::AUTO && written >= give_up_at) {
+            _frame_start = std::max<int64_t>(written - frame_len, 0);
+            break;
+        }
+
+        // Caught up with live data: the trigger is armed again.
+        if (_frame_end_pos >= 0) {
+            const double frame_end_s = _stream_t0 + _frame_end_pos / rate;
+            _rearm_time.record(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(steady_now_s() - frame_end_s)
+            ));
+            _frame_end_pos = -1;
+        }
+
+        if (written != last_written) {
+            last_written = written;
+            stall_deadline_s = steady_now_s() + 2.0 * n / rate + 0.1;
+        } else if (steady_now_s() > stall_deadline_s) {
+            // The DMA stalled; see _wait_stream_segment().
+            _restart_stream();
+            return false;
+        }
+        if (steady_now_s() > deadline_s) return false;
+        std::this_thread::sleep_for(std::chrono::duration<double>(poll_s));
+    }
+    if (!keep_going) return false;
+
+    _frame_trig_start.reset();
+    if (trig_pos) {
+        _frame_start = std::max<int64_t>(*trig_pos - pre, 0) & ~int64_t(1);
+        _frame_trig_start = static_cast<int>(*trig_pos - _frame_start);
+
+        // Wait for the post-trigger part of the frame.
+        while (keep_going && _stream_write_pos() < _frame_start + frame_len) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(poll_s));
+        }
+        if (!keep_going) return false;
+    }
+
+    // Rearm after the frame and hold-off; nothing inside the frame triggers
+    // again. Auto-range thresholds come from what was scanned up to here.
+    _frame_end_pos = _frame_start + frame_len;
+    _scan_pos = std::max(_scan_pos, _frame_end_pos + (trig.skip_samples & ~1));
+    _scan_armed_at = -1;
+    if (_scan_count > 0) {
+        const float mean_val = static_cast<float>(_scan_sum / _scan_count);
+        const float range = _scan_max - _scan_min;
+        _auto_thresh = {mean_val - 0.2f * range, mean_val + 0.2f * range};
+        _scan_count = 0;
+        _scan_sum = 0.0;
+    }
+    return true;
+}
+
+void ParallelADC::_finish_pretrigger(Capture& target) {
+    _copy_stream(_frame_start, _n_samples, target.words.data());
+    _set_channel_fields(target);
+
+    target.t0 = _stream_t0 + _frame_start / static_cast<double>(_cur_real_sample_rate);
+    target.skip_samples = 0;
+    target.triggered = _frame_trig_start.has_value();
+    target.trig_start = _frame_trig_start;
+
+    // The pre-trigger window was overwritten while we copied.
+    if (_stream_write_pos() - _frame_start > int64_t(_n_samples) * _n_ring_segments) {
+        ++_acq_overruns;
+    }
+}
+
+// ---- Segmented capture ----------------------------------------------------
+
+int ParallelADC::_capture_segments(
+    int n_segments, int segment_samples, float pre_fraction, double timeout_s,
+    uint16_t* words, uint64_t* stamps, std::vector<ChannelField>& channels
+) {
+    if (_logic_analyzer_mode) {
+        throw std::runtime_error("Segmented capture is not available in logic analyzer mode.");
+    }
+    if (_cur_real_sample_rate == 0) {
+        throw std::runtime_error("Call start_sampling() before capture_segments().");
+    }
+    if ((segment_samples % 2) != 0 || segment_samples > _n_samples) {
+        throw std::runtime_error("segment_samples must be even and at most n_samples.");
+    }
+
+    // Records are cut from the continuous ring as in pre-trigger mode, so
+    // the next one is armed as soon as the last one's samples are in.
+    const bool was_continuous = _continuous;
+    const bool was_pretrigger = _pretrigger;
+    if (!was_continuous) set_continuous(true);
+
+    Capture fields;
+    fields.channels.resize(_n_channels);
+    _set_channel_fields(fields);
+    channels = fields.channels;
+
+    const TriggerSettings trig = trigger_settings();
+    const int64_t pre = static_cast<int64_t>(pre_fraction * segment_samples) & ~int64_t(1);
+    const int64_t ring = int64_t(_n_samples) * _n_ring_segments;
+    const double rate = _cur_real_sample_rate;
+    const double ticks_per_s = static_cast<double>(read_cntfrq_el0());
+    const double deadline_s = steady_now_s() + timeout_s;
+    const std::atomic<bool> keep_going{true};  // only the deadline ends it
+
+    int n_captured = 0;
+    _start_stream();
+    while (n_captured < n_segments && steady_now_s() < deadline_s) {
+        if (!_scan_frame(segment_samples, pre, trig, keep_going, deadline_s)) continue;
+
+        _copy_stream(_frame_start, segment_samples, words + size_t(n_captured) * segment_samples);
+        if (_stream_write_pos() - _frame_start > ring) ++_acq_overruns;  // torn while copying
+
+        // Untriggered records are stamped where the trigger would have been.
+        const int64_t trig_pos = _frame_start + _frame_trig_start.value_or(static_cast<int>(pre));
+        stamps[n_captured] = _stream_t0_ticks + static_cast<uint64_t>(std::llround(trig_pos / rate * ticks_per_s));
+        ++n_captured;
+    }
+    _stop_stream();
+
+    if (!was_continuous) set_continuous(false);
+    _pretrigger = was_pretrigger;
+    return n_captured;
 }
 
 void ParallelADC::_on_la_mode_exit() {
+    // LA mode may have retimed the SMI, or not used it at all; make the next
+    // start_sampling() set it up again.
+    _cur_real_sample_rate = 0;
+
     // Re-allocate the SMI receive buffer if it was freed when LA mode was entered.
-    if (!_data.vc_handle) {
-        _data = _dma._mbox.alloc_vc_mem(_n_samples * sizeof(uint16_t), _asi.page_size);
-        _rx_data_virt = (uint16_t*)_data.virt;
-        _rx_data_bus  = (uint16_t*)_data.bus;
-    }
-    _resize_flat_bufs(_n_channels, _n_samples);
+    if (!_data.vc_handle) _alloc_rx_buf();
+    _resize_captures(_n_channels, _n_samples);
     _setup_dma_cbs();
 }
@@ -24,27 +24,138 @@ class ParallelADC : public ADC {
         int n_active_channels() const override;
         void set_attenuation(int channel, bool att_on);
 
+        int bit_format() const override { return _bit_format; }
+        void set_bit_format(int bit_format);
+
+        // Gapless acquisition: the DMA chain loops over a ring of n_segments
+        // capture-sized receive segments and the SMI keeps sampling between
+        // captures. The worker publishes segments in order as they complete;
+        // segments the worker falls too far behind to read are counted in
+        // acquisition_stats().overruns and skipped. The SMI's transfer count
+        // runs out after about 2^31 samples (34 s at 62.5 MS/s), so the
+        // stream is restarted shortly before then; each restart leaves a gap
+        // of a few segments, counted in acquisition_stats().stream_restarts
+        // and visible in its dead time.
+        void set_continuous(bool enable, int n_segments=4);
+        bool continuous() const { return _continuous; }
+        int n_ring_segments() const { return _n_ring_segments; }
+
+        // Pre-trigger acquisition, on top of continuous mode (enabled with
+        // it if needed): the worker scans the stream for the trigger as it
+        // arrives and cuts each frame so the trigger sits pre_fraction of the
+        // way in, after a guaranteed pre-trigger window. Frames never
+        // overlap; skip_samples from set_trigger() is an extra hold-off.
+        void set_pretrigger(bool enable, float pre_fraction=0.1f);
+        bool pretrigger() const { return _pretrigger; }
+        float pretrigger_fraction() const { return _pretrigger_fraction; }
+
     protected:
         uint32_t _cur_real_sample_rate = 0;
         int _bit_format;
 
         void _start_fetch() override;
-        void _finish_fetch(float* target) override;
+        bool _wait_fetch() override;
+        void _finish_fetch(Capture& target) override;
         void _abort_fetch() override;
+        bool _fetch_sets_trigger() const override { return _pretrigger && !_logic_analyzer_mode; }
         double _get_sample_rate_hz() const override { return _cur_real_sample_rate; }
+        double _fetch_lead_time_s(double rate_hz, double elapsed_s) const override;
         void _on_la_mode_exit() override;
-
-        float _sample_to_float(uint8_t raw_sample) const;
+        int _code_bits() const override { return 8; }
+        float _code_to_float(uint32_t code) const override;
 
         int _highest_active_channel() const;
 
-        void _setup_dma_cbs();
+        // (Re)allocate the receive buffer for _n_ring_segments segments.
+        void _alloc_rx_buf();
+
+        // One CB chain per receive segment. Outside continuous mode each
+        // chain ends on its own and the worker alternates between two.
+        void _setup_dma_cbs() override;
+        int  _n_cbs_per_seg = 0;
+
+        // Fill target's words and channel fields from one segment of rx data.
+        void _unpack_rx(const uint16_t* rx, Capture& target) const;
+        void _set_channel_fields(Capture& target) const;
+
+        // Receive segments, _seg_stride bytes apart: two alternating ones
+        // normally, the ring in continuous mode.
+        int     _n_ring_segments = 2;
+        int     _seg_stride = 0;
+        int     _rx_fill  = 0;  // segment the next one-shot transfer writes
+        int     _rx_ready = 0;  // last completed segment, for _finish_fetch()
+
+        // Continuous mode. Segment i (counted from the stream start) lands in
+        // ring slot i % _n_ring_segments.
+        bool    _continuous = false;
+        bool    _stream_running = false;
+        int64_t _stream_next = 0;     // next segment the worker will consume
+        int64_t _stream_ready = 0;    // segment _wait_fetch() handed over
+        double  _stream_t0 = 0.0;     // stream start, seconds on the steady clock
+        uint64_t _stream_t0_ticks = 0; // and in cntvct_el0 ticks
+
+        // The last write position _stream_write_pos() saw and when, in
+        // cntvct_el0 ticks. Worker-only; see _stream_write_pos().
+        mutable int64_t  _stream_seen_pos = 0;
+        mutable uint64_t _stream_seen_ticks = 0;
+
+        void _start_stream();
+        void _stop_stream();
+        // Stop and start again, for a stalled stream or one whose SMI count
+        // is about to run out.
+        void _restart_stream();
+        bool _stream_near_end() const;
+        bool _wait_stream_segment();
+        void _finish_stream_segment(Capture& target);
+
+        // Samples written since the stream started (always even), and the
+        // segment the DMA is writing; all segments before it are complete.
+        // Never goes backwards, and stays put while the DMA makes no progress.
+        int64_t _stream_write_pos() const;
+        // How long a clock/register read pair may take before it is retried.
+        uint64_t _stream_max_skew_ticks() const;
+        int64_t _stream_write_segment() const { return _stream_write_pos() / _n_samples; }
+
+        // Unpack stream samples [begin, begin + count) from the ring. begin
+        // and count must be even.
+        void _copy_stream(int64_t begin, int count, uint16_t* dst) const;
+
+        // Pre-trigger mode state, worker-only. Positions count stream samples.
+        bool    _pretrigger = false;
+        float   _pretrigger_fraction = 0.1f;
+        int64_t _scan_pos = 0;         // next sample to scan for the trigger
+        int64_t _scan_origin = 0;      // sample find_edge() indices are relative to
+        int     _scan_armed_at = -1;   // find_edge() arm state, carried across chunks
+        float   _scan_min = 0.0f;      // channel 0 since the last frame, for auto_range
+        float   _scan_max = 0.0f;
+        double  _scan_sum = 0.0;
+        int64_t _scan_count = 0;
+        std::optional<std::pair<float, float>> _auto_thresh;
+        int64_t _frame_start = 0;      // first sample of the frame to hand over
+        int64_t _frame_end_pos = -1;   // end of the last frame until scanning catches up
+        std::optional<int> _frame_trig_start;
+        std::vector<uint16_t> _scan_words;
+        std::vector<float>    _scan_vals;
+
+        void _reset_scan();
+        bool _wait_pretrigger();
+
+        // Scan the stream for the next trigger and wait for a frame of
+        // frame_len samples around it, pre of them before the trigger. Sets
+        // _frame_start and _frame_trig_start; false if keep_going was
+        // cleared, the deadline passed, or the stream had to be restarted.
+        bool _scan_frame(
+            int64_t frame_len, int64_t pre, const TriggerSettings& trig,
+            const std::atomic<bool>& keep_going, double deadline_s
+        );
+
+        int _capture_segments(
+            int n_segments, int segment_samples, float pre_fraction, double timeout_s,
+            uint16_t* words, uint64_t* stamps, std::vector<ChannelField>& channels
+        ) override;
+        void _finish_pretrigger(Capture& target);
 
         MemPtrs   _data;
         uint16_t* _rx_data_virt = nullptr;
         uint16_t* _rx_data_bus  = nullptr;
-
-        SMI _smi;
-
-        const int _dma_chan_0 = 9;
 };
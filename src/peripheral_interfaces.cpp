@@ -39,13 +39,25 @@ PYBIND11_MODULE(peripheral_interfaces, m, py::mod_gil_not_used()) {
         .value("ALT_5", GPIOMode::ALT_5)
         .export_values();
 
+    // Bound in both modules, so local to each.
+    py::class_<RealtimeStatus>(m, "RealtimeStatus", py::module_local())
+        .def_readonly("cpus", &RealtimeStatus::cpus)
+        .def_readonly("fifo", &RealtimeStatus::fifo)
+        .def_readonly("priority", &RealtimeStatus::priority)
+        .def_readonly("memory_locked", &RealtimeStatus::memory_locked)
+        .def_readonly("isolated_cpus", &RealtimeStatus::isolated_cpus);
+
     py::class_<FrequencyCounter>(m, "FrequencyCounter")
         .def(
             py::init<int, int, int, int>(),
             py::arg("tgt_sample_rate")=50'000'000,
             py::arg("n_samples")=16384,
             py::arg("gpio_pin")=8,
-            py::arg("dma_chan")=10
+            py::arg("dma_chan")=-1
         )
-        .def("sample", &FrequencyCounter::sample);
+        .def("sample", &FrequencyCounter::sample)
+        .def("set_realtime", &FrequencyCounter::set_realtime,
+             py::arg("cpu")=3, py::arg("fifo_priority")=80, py::arg("lock_memory")=true)
+        .def("clear_realtime", &FrequencyCounter::clear_realtime)
+        .def_property_readonly("realtime_status", &FrequencyCounter::realtime_status);
 }
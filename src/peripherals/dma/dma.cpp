@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
@@ -5,6 +6,7 @@
 #include <iostream>
 #include <sstream>
 #include <thread>
+#include <poll.h>
 #include <unistd.h>
 
 #include "peripherals/dma/dma.hpp"
@@ -76,6 +78,14 @@ void DMA::resize_cbs(int new_size) {
     }
 }
 
+void DMA::load_chain(const DMAChain& chain) {
+    // Check before resizing: the current CBs may still be in use.
+    chain.validate();
+    resize_cbs(chain.size());
+    const auto cbs = chain.resolve(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(_cb_mem.bus)));
+    std::memcpy(_cb_mem.virt, cbs.data(), cbs.size() * sizeof(DMAControlBlock));
+}
+
 DMAControlBlock& DMA::get_cb(size_t i) {
     if (i >= _n_cbs) {
         throw std::runtime_error("Index out of range.");
@@ -106,14 +116,18 @@ const DMAControlBlock* DMA::get_cb_bus_ptr(size_t i) const {
 
 void DMA::show_active_dma_chans() const {
     for (uint32_t i=0; i < N_DMA_CHANS; ++i) {
-        const bool global_enable = (*_enable_reg) & (1 << i);
-        const bool enabled = global_enable && ((*_src_regs[i] != 0) || (*_dst_regs[i] != 0));
-        if (enabled) {
+        if (channel_in_use(i)) {
             std::cout << "DMA channel " << i << " enabled." << std::endl;
         }
     }
 }
 
+bool DMA::channel_in_use(int channel) const {
+    const bool global_enable = (*_enable_reg) & (1 << channel);
+    return _cs_regs[channel]->flags.active
+        || (global_enable && ((*_src_regs[channel] != 0) || (*_dst_regs[channel] != 0)));
+}
+
 void DMA::reset(int channel) const {
     _cs_regs[channel]->flags.reset = 1;
 }
@@ -168,3 +182,99 @@ bool DMA::wait(int channel, int max_retries, int delay_us) const {
 
     return success;
 }
+
+DMAWaitStatus DMA::wait_done(
+    int channel,
+    std::chrono::steady_clock::time_point started,
+    const DMAWaitPolicy& policy,
+    const std::atomic<bool>* keep_going,
+    Log2Histogram* wake_lateness
+) const {
+    using clock = std::chrono::steady_clock;
+    const auto to_dur = [](double s) {
+        return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(s));
+    };
+    const auto going  = [&] { return !keep_going || keep_going->load(std::memory_order_relaxed); };
+    const auto active = [&] { return _cs_regs[channel]->flags.active != 0; };
+
+    const auto expected_at = started + to_dur(policy.expected_s);
+    const auto give_up_at  = expected_at + to_dur(policy.timeout_s);
+    const auto spin_window = to_dur(policy.spin_window_s);
+    const auto check_every = std::chrono::milliseconds(5);  // for keep_going
+
+    const auto sleep_until = [&](clock::time_point target) {
+        std::this_thread::sleep_until(target);
+        if (wake_lateness) {
+            const auto late = clock::now() - target;
+            wake_lateness->record(std::max<int64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(late).count(), 0
+            ));
+        }
+    };
+
+    if (policy.irq_fd >= 0) {
+        // The interrupt does the waiting; the status checks below decide.
+        while (going() && active() && clock::now() < give_up_at) {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                give_up_at - clock::now()
+            );
+            pollfd pfd{.fd=policy.irq_fd, .events=POLLIN, .revents=0};
+            const int timeout_ms = static_cast<int>(std::clamp(left, std::chrono::milliseconds(1), check_every).count());
+            if (poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN)) {
+                // UIO: read the event count, then re-enable the interrupt.
+                uint32_t n_events;
+                const uint32_t unmask = 1;
+                if (read(policy.irq_fd, &n_events, sizeof(n_events)) < 0
+                    || write(policy.irq_fd, &unmask, sizeof(unmask)) < 0) break;
+            }
+        }
+    } else {
+        const auto wake_at = expected_at - to_dur(policy.sleep_margin_s);
+        while (going() && active() && clock::now() < wake_at) {
+            sleep_until(std::min(wake_at, clock::now() + check_every));
+        }
+    }
+
+    DMAWaitStatus status;
+    bool first_look = true;
+    while (true) {
+        const auto now = clock::now();
+        // A channel that stopped on an error is idle too; that's not done.
+        if (_cs_regs[channel]->flags.error) {
+            status.result = DMAWaitResult::ERROR;
+            break;
+        }
+        if (!active()) {
+            status.result = DMAWaitResult::DONE;
+            status.saw_completion = !first_look;
+            break;
+        }
+        if (!going()) {
+            status.result = DMAWaitResult::ABORTED;
+            break;
+        }
+        if (now >= give_up_at) {
+            status.result = DMAWaitResult::TIMEOUT;
+            break;
+        }
+        first_look = false;
+
+        // Spin within spin_window of the expected time and yield either side
+        // of it; once the transfer is well overdue, sleep in short steps.
+        const auto late = now - expected_at;
+        if (late >= std::chrono::milliseconds(1)) {
+            sleep_until(std::min(now + std::chrono::microseconds(100), give_up_at));
+        } else if (late <= -spin_window || late >= spin_window) {
+            std::this_thread::yield();
+        }
+    }
+
+    if (policy.irq_fd >= 0 && status.ok()) {
+        // Acknowledge the interrupt (write-1-to-clear) now that the channel is idle.
+        _cs_regs[channel]->bits = DMAControlStatus{{.end=1, .int_status=1}}.bits;
+    }
+
+    status.bytes_remaining = *_len_regs[channel];
+    status.elapsed_s = std::chrono::duration<double>(clock::now() - started).count();
+    return status;
+}
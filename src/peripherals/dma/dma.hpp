@@ -1,12 +1,51 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <vector>
 
+#include "peripherals/dma/dma_chain.hpp"
+#include "peripherals/dma/dma_channels.hpp"
 #include "peripherals/dma/dma_defs.hpp"
 #include "peripherals/mailbox/mailbox.hpp"
 #include "peripherals/peripheral.hpp"
+#include "utils/log2_histogram.hpp"
 #include "utils/reg_mem_utils.hpp"
 
+enum class DMAWaitResult {
+    DONE,     // the channel went idle
+    TIMEOUT,  // still active at the deadline
+    ERROR,    // the channel flagged an error
+    ABORTED   // the caller's keep_going flag was cleared
+};
+
+struct DMAWaitStatus {
+    DMAWaitResult result = DMAWaitResult::DONE;
+    uint32_t bytes_remaining = 0;  // TXFR_LEN when the wait ended
+    double   elapsed_s = 0.0;      // from the transfer start to when the wait ended
+
+    // True if the transfer was seen finishing while polling, so elapsed_s
+    // is its duration; false if it was already done at the first look.
+    bool     saw_completion = false;
+
+    bool ok() const { return result == DMAWaitResult::DONE; }
+};
+
+// How DMA::wait_done() spends the time until a transfer should complete: it
+// sleeps until sleep_margin_s before the expected completion, yields until
+// spin_window_s before it, then spins. A transfer that runs late gets
+// progressively coarser polling until timeout_s past the expected time.
+struct DMAWaitPolicy {
+    double expected_s     = 0.0;     // from the transfer start to completion
+    double timeout_s      = 0.1;     // past expected_s before giving up
+    double sleep_margin_s = 200e-6;  // covers the scheduler's wake-up lateness
+    double spin_window_s  = 20e-6;
+
+    // UIO-style fd that becomes readable on the channel's interrupt, or -1
+    // to poll. The chain's last CB must set int_enable.
+    int irq_fd = -1;
+};
+
 class DMA : public Peripheral {
     public:
         DMA(int n_cbs=0);
@@ -14,7 +53,16 @@ class DMA : public Peripheral {
 
         void show_active_dma_chans() const;
 
+        // Running, or enabled with a source or destination loaded: someone
+        // has used the channel since it was last disabled.
+        bool channel_in_use(int channel) const;
+
         void resize_cbs(int new_size);
+
+        // Resize to fit chain and write it, validated and with its links
+        // resolved, into CB memory in a single copy. CB 0 is its first CB.
+        void load_chain(const DMAChain& chain);
+
         void reset(int channel) const;
         void enable(int channel) const;
         void disable(int channel) const;
@@ -22,12 +70,24 @@ class DMA : public Peripheral {
         void start(int channel, int first_cb_idx) const;
         bool wait(int channel, int max_retries=10, int delay_us=100) const;
 
+        // Wait for a transfer started at `started` per policy. Stops early,
+        // with ABORTED, once keep_going reads false. Every sleep's overshoot
+        // past its intended wake time goes into wake_lateness if given.
+        DMAWaitStatus wait_done(
+            int channel,
+            std::chrono::steady_clock::time_point started,
+            const DMAWaitPolicy& policy,
+            const std::atomic<bool>* keep_going = nullptr,
+            Log2Histogram* wake_lateness = nullptr
+        ) const;
+
         DMAControlBlock& get_cb(size_t i);
         const DMAControlBlock& get_cb(size_t i) const;
 
         DMAControlBlock* get_cb_bus_ptr(size_t i);
         const DMAControlBlock* get_cb_bus_ptr(size_t i) const;
 
+        volatile uint32_t* _src_regs[N_DMA_CHANS];
         volatile uint32_t* _dst_regs[N_DMA_CHANS];
         volatile uint32_t* _len_regs[N_DMA_CHANS];
 
@@ -43,6 +103,5 @@ class DMA : public Peripheral {
         volatile DMAControlStatus* _cs_regs[N_DMA_CHANS];
         volatile uint32_t* _cb_addr_regs[N_DMA_CHANS];
         volatile DMATransferInfo* _ti_regs[N_DMA_CHANS];
-        volatile uint32_t* _src_regs[N_DMA_CHANS];
         volatile uint32_t* _debug_regs[N_DMA_CHANS];
 };
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "peripherals/dma/dma_chain.hpp"
+
+int DMAChain::add(uint32_t ti, uint32_t src, uint32_t dst, uint32_t len) {
+    const int i = static_cast<int>(_cbs.size());
+    _cbs.push_back(DMAControlBlock{.ti=ti, .src=src, .dst=dst, .len=len});
+    _next.push_back(i + 1);
+    return i;
+}
+
+int DMAChain::peri_to_mem(
+    uint32_t ti, uint32_t src, uint32_t dst,
+    uint32_t n_bytes, uint32_t max_chunk, uint32_t align
+) {
+    max_chunk -= max_chunk % align;
+    if (n_bytes == 0 || max_chunk == 0) {
+        throw std::runtime_error("DMAChain::peri_to_mem(): nothing to transfer.");
+    }
+
+    const uint32_t n_cbs = (n_bytes + max_chunk - 1) / max_chunk;
+    uint32_t chunk = (n_bytes + n_cbs - 1) / n_cbs;
+    chunk = std::min(max_chunk, (chunk + align - 1) / align * align);
+
+    const int first = static_cast<int>(_cbs.size());
+    for (uint32_t remaining = n_bytes; remaining > 0; ) {
+        const uint32_t len = std::min(chunk, remaining);
+        add(ti, src, dst, len);
+        dst       += len;
+        remaining -= len;
+    }
+    return first;
+}
+
+int DMAChain::paced(
+    uint32_t pace_peri_map, uint32_t pace_fifo,
+    uint32_t ti, uint32_t src, uint32_t dst, uint32_t len
+) {
+    const int first = add(dma_ti_pace(pace_peri_map), 0, pace_fifo, 4);
+    add(ti, src, dst, len);
+    return first;
+}
+
+void DMAChain::link(int from, int to) {
+    _check_index(from, "link source");
+    if (to != STOP) _check_index(to, "link target");
+    _next[from] = to;
+}
+
+void DMAChain::interrupt(int i) {
+    _check_index(i, "interrupt");
+    _cbs[i].ti |= DMA_TI_INT_ENABLE;
+}
+
+void DMAChain::src_to_cb(int i, int target, uint32_t field) {
+    _add_cb_ref(i, /*dst=*/false, target, field);
+}
+
+void DMAChain::dst_to_cb(int i, int target, uint32_t field) {
+    _add_cb_ref(i, /*dst=*/true, target, field);
+}
+
+void DMAChain::_add_cb_ref(int i, bool dst, int target, uint32_t field) {
+    _check_index(i, "CB reference source");
+    _check_index(target, "CB reference target");
+    if (field >= sizeof(DMAControlBlock) || field % 4) {
+        throw std::runtime_error("DMAChain: CB reference field is not a word within the CB.");
+    }
+    _cb_refs.push_back(CBRef{.cb=i, .dst=dst, .target=target, .field=field});
+}
+
+void DMAChain::_check_index(int i, const char* what) const {
+    if (i < 0 || i >= static_cast<int>(_cbs.size())) {
+        std::ostringstream ss;
+        ss << "DMAChain: " << what << " CB " << i << " is outside the chain of " << _cbs.size() << ".";
+        throw std::runtime_error(ss.str());
+    }
+}
+
+void DMAChain::validate() const {
+    const int n = static_cast<int>(_cbs.size());
+    for (int i = 0; i < n; ++i) {
+        const auto& cb = _cbs[i];
+        const DMATransferInfo ti{.bits=cb.ti};
+        const char* problem = nullptr;
+
+        if (cb.len == 0 || cb.len > _max_len) {
+            problem = "length is 0 or too long for the channel";
+        } else if ((ti.flags.src_dma_req && cb.src % 4) || (ti.flags.dest_dma_req && cb.dst % 4)) {
+            problem = "peripheral address is not word aligned";
+        } else if ((ti.flags.src_width_128 && cb.src % 16) || (ti.flags.dest_width_128 && cb.dst % 16)) {
+            problem = "128-bit wide address is not 16-byte aligned";
+        } else if (_next[i] == n) {
+            problem = "runs off the end of the chain";
+        } else if (_next[i] != STOP && (_next[i] < 0 || _next[i] >= n)) {
+            problem = "links outside the chain";
+        }
+
+        if (problem) {
+            std::ostringstream ss;
+            ss << "DMAChain: CB " << i << " " << problem << " (len " << cb.len
+               << ", src 0x" << std::hex << cb.src << ", dst 0x" << cb.dst << ").";
+            throw std::runtime_error(ss.str());
+        }
+    }
+}
+
+std::vector<DMAControlBlock> DMAChain::resolve(uint32_t cb0_bus) const {
+    if (cb0_bus % alignof(DMAControlBlock)) {
+        throw std::runtime_error("DMAChain: CB memory is not 32-byte aligned.");
+    }
+
+    std::vector<DMAControlBlock> out(_cbs);
+    for (size_t i = 0; i < out.size(); ++i) {
+        out[i].next_cb = (_next[i] == STOP)
+            ? 0 : cb0_bus + static_cast<uint32_t>(_next[i] * sizeof(DMAControlBlock));
+    }
+    for (const auto& ref : _cb_refs) {
+        const uint32_t addr = cb0_bus + static_cast<uint32_t>(ref.target * sizeof(DMAControlBlock)) + ref.field;
+        (ref.dst ? out[ref.cb].dst : out[ref.cb].src) = addr;
+    }
+    return out;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "peripherals/dma/dma_defs.hpp"
+
+/*
+ * Host-side builder for a chain of DMA control blocks.
+ *
+ * CBs are appended as pieces (single transfers, chunked peripheral reads,
+ * paced transfers) and refer to each other by index. Each CB falls through
+ * to the one appended after it unless link() or stop() says otherwise.
+ * Nothing touches uncached memory until DMA::load_chain(), which validates
+ * the whole chain, resolves the links to bus addresses and copies it into
+ * CB memory in one go.
+ */
+class DMAChain {
+    public:
+        static constexpr int STOP = -1;
+
+        // max_len bounds every CB's length: DMA_LITE_MAX_XFER_LEN for
+        // chains that will run on a Lite channel.
+        explicit DMAChain(uint32_t max_len=DMA_MAX_XFER_LEN) : _max_len(max_len) {}
+
+        size_t size() const { return _cbs.size(); }
+        int last() const { return static_cast<int>(_cbs.size()) - 1; }
+        void reserve(size_t n) { _cbs.reserve(n); _next.reserve(n); }
+
+        // One transfer of len bytes. Returns its index.
+        int add(uint32_t ti, uint32_t src, uint32_t dst, uint32_t len);
+
+        // n_bytes from a peripheral into memory at dst, over the fewest CBs of
+        // at most max_chunk bytes. The bytes are spread evenly across them, in
+        // multiples of align, so the last CB is never tiny: a tiny last CB can
+        // miss the DREQ of a peripheral that deasserts it once its own count
+        // runs out. Returns the index of the first.
+        int peri_to_mem(
+            uint32_t ti, uint32_t src, uint32_t dst,
+            uint32_t n_bytes, uint32_t max_chunk, uint32_t align=1
+        );
+
+        // Wait for the pacing peripheral's DREQ (consuming it with a write to
+        // pace_fifo), then do one transfer. Returns the index of the pacing CB;
+        // the transfer is the one after it.
+        int paced(
+            uint32_t pace_peri_map, uint32_t pace_fifo,
+            uint32_t ti, uint32_t src, uint32_t dst, uint32_t len
+        );
+
+        // Continue at CB `to` after CB `from`. link(i, i) loops on one CB.
+        void link(int from, int to);
+        void stop(int i) { link(i, STOP); }
+
+        // Raise the channel's interrupt when CB i completes.
+        void interrupt(int i);
+
+        // Point CB i's source or destination at byte offset `field` (e.g.
+        // offsetof(DMAControlBlock, dst)) of CB target, for chains that
+        // rewrite their own CBs as they run. Resolved along with the links.
+        void src_to_cb(int i, int target, uint32_t field);
+        void dst_to_cb(int i, int target, uint32_t field);
+
+        // Throws std::runtime_error naming the first CB with a length of 0 or
+        // over max_len, a DREQ-paced or 128-bit-wide address that is not
+        // aligned for it, a link outside the chain, or that runs off the end.
+        void validate() const;
+
+        // The chain, which should have passed validate(), with links pointing
+        // at CBs laid out contiguously from cb0_bus.
+        std::vector<DMAControlBlock> resolve(uint32_t cb0_bus) const;
+
+    private:
+        uint32_t _max_len;
+        std::vector<DMAControlBlock> _cbs;
+        std::vector<int> _next;  // index of the next CB, or STOP
+
+        struct CBRef {
+            int cb;
+            bool dst;
+            int target;
+            uint32_t field;
+        };
+        std::vector<CBRef> _cb_refs;
+
+        void _check_index(int i, const char* what) const;
+        void _add_cb_ref(int i, bool dst, int target, uint32_t field);
+};
@@ -0,0 +1,116 @@
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "peripherals/dma/dma.hpp"
+#include "peripherals/dma/dma_channels.hpp"
+#include "peripherals/dma/dma_defs.hpp"
+
+// ---- DMAChannel --------------------------------------------------------------
+
+DMAChannel::DMAChannel(DMAChannel&& other) noexcept : _dma(other._dma), _id(other._id) {
+    other._dma = nullptr;
+    other._id = -1;
+}
+
+DMAChannel& DMAChannel::operator=(DMAChannel&& other) noexcept {
+    if (this != &other) {
+        release();
+        _dma = other._dma;
+        _id = other._id;
+        other._dma = nullptr;
+        other._id = -1;
+    }
+    return *this;
+}
+
+void DMAChannel::release() {
+    if (_id < 0) return;
+
+    _dma->reset(_id);
+    _dma->disable(_id);
+    DMAChannelRegistry::instance()._release(_id);
+    _dma = nullptr;
+    _id = -1;
+}
+
+// ---- DMAChannelRegistry ------------------------------------------------------
+
+// The channels the firmware leaves to the ARM, or all of them if the device
+// tree doesn't say.
+static uint32_t read_channel_mask() {
+    const std::filesystem::path soc = "/proc/device-tree/soc";
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(soc, ec)) {
+        if (entry.path().filename().string().find("7e007000") == std::string::npos) continue;
+
+        std::ifstream mask_file(entry.path() / "brcm,dma-channel-mask", std::ios::binary);
+        uint32_t mask;
+        if (!mask_file.read((char*)&mask, sizeof(mask))) continue;
+
+        // Device tree cells are big-endian.
+        if (std::endian::native != std::endian::big) {
+            mask = std::byteswap(mask);
+        }
+        return mask & ((1u << N_DMA_CHANS) - 1);
+    }
+    return (1u << N_DMA_CHANS) - 1;
+}
+
+DMAChannelRegistry::DMAChannelRegistry() : _available(read_channel_mask()) {}
+
+DMAChannelRegistry& DMAChannelRegistry::instance() {
+    static DMAChannelRegistry registry;
+    return registry;
+}
+
+bool DMAChannelRegistry::_free(const DMA& dma, int chan) const {
+    return !(_claimed & (1u << chan)) && (_available & (1u << chan)) && !dma.channel_in_use(chan);
+}
+
+DMAChannel DMAChannelRegistry::acquire(const DMA& dma, DMAChannelKind kind) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Highest first, away from the low channels the kernel's driver takes.
+    for (int chan = N_DMA_CHANS - 1; chan >= 0; --chan) {
+        if (kind == DMAChannelKind::FULL && dma_chan_is_lite(chan)) continue;
+        if (_free(dma, chan)) {
+            _claimed |= (1u << chan);
+            return DMAChannel(&dma, chan);
+        }
+    }
+
+    std::ostringstream ss;
+    ss << "No free " << (kind == DMAChannelKind::FULL ? "full " : "") << "DMA channel (claimed mask 0x"
+       << std::hex << _claimed << ", available mask 0x" << _available << ").";
+    throw std::runtime_error(ss.str());
+}
+
+DMAChannel DMAChannelRegistry::acquire(const DMA& dma, int chan) {
+    if (chan < 0 || chan >= static_cast<int>(N_DMA_CHANS)) {
+        throw std::runtime_error("DMA channel out of range.");
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_free(dma, chan)) {
+        std::ostringstream ss;
+        ss << "DMA channel " << chan << " is "
+           << ((_claimed & (1u << chan)) ? "already claimed in this process" :
+               !(_available & (1u << chan)) ? "reserved by the firmware" : "in use") << ".";
+        throw std::runtime_error(ss.str());
+    }
+    _claimed |= (1u << chan);
+    return DMAChannel(&dma, chan);
+}
+
+uint32_t DMAChannelRegistry::claimed_mask() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _claimed;
+}
+
+void DMAChannelRegistry::_release(int chan) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _claimed &= ~(1u << chan);
+}
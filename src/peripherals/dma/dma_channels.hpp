@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "peripherals/dma/dma_defs.hpp"
+
+class DMA;
+
+// Channels 0-6 are full DMA channels. Channels 7-14 are DMA Lite: a 16-bit
+// length field, no 2D mode and narrower bursts.
+enum class DMAChannelKind {
+    LITE,  // anything will do; Lite channels go first
+    FULL   // needs a full channel
+};
+
+inline constexpr bool dma_chan_is_lite(int chan) { return chan >= 7; }
+
+/*
+ * A DMA channel claimed from DMAChannelRegistry, given back when this is
+ * destroyed. Releasing resets the channel and clears its global enable bit,
+ * which is how the registry tells a channel nobody is using from one the
+ * kernel or another process is. Must not outlive the DMA it came with.
+ */
+class DMAChannel {
+    public:
+        DMAChannel() = default;
+        ~DMAChannel() { release(); }
+
+        DMAChannel(DMAChannel&& other) noexcept;
+        DMAChannel& operator=(DMAChannel&& other) noexcept;
+        DMAChannel(const DMAChannel&) = delete;
+        DMAChannel& operator=(const DMAChannel&) = delete;
+
+        int id() const { return _id; }
+        bool lite() const { return dma_chan_is_lite(_id); }
+        uint32_t max_xfer_len() const { return lite() ? DMA_LITE_MAX_XFER_LEN : DMA_MAX_XFER_LEN; }
+        explicit operator bool() const { return _id >= 0; }
+
+        void release();
+
+    private:
+        friend class DMAChannelRegistry;
+        DMAChannel(const DMA* dma, int id) : _dma(dma), _id(id) {}
+
+        const DMA* _dma = nullptr;
+        int _id = -1;
+};
+
+/*
+ * Process-wide bookkeeping of DMA channels, so several instruments can run
+ * at once without being handed the same channel.
+ *
+ * A channel is free if no DMAChannel in this process holds it, the firmware
+ * lets the ARM have it (the device tree's brcm,dma-channel-mask), and it
+ * doesn't look in use in the hardware: active, or enabled with a source or
+ * destination loaded, as DMA::show_active_dma_chans() reports. That last
+ * check is what keeps channels the kernel has used out of reach.
+ */
+class DMAChannelRegistry {
+    public:
+        static DMAChannelRegistry& instance();
+
+        // The highest-numbered free channel of kind, read through dma's
+        // registers. Throws std::runtime_error if there is none.
+        DMAChannel acquire(const DMA& dma, DMAChannelKind kind=DMAChannelKind::LITE);
+
+        // Exactly channel chan; throws if it is not free.
+        DMAChannel acquire(const DMA& dma, int chan);
+
+        // Bit i set if channel i is held in this process.
+        uint32_t claimed_mask() const;
+
+        // Channels the ARM may use, from the device tree.
+        uint32_t available_mask() const { return _available; }
+
+    private:
+        DMAChannelRegistry();
+        friend class DMAChannel;
+
+        mutable std::mutex _mutex;
+        uint32_t _claimed = 0;
+        uint32_t _available;
+
+        bool _free(const DMA& dma, int chan) const;
+        void _release(int chan);
+};
@@ -25,6 +25,11 @@ static constexpr uint32_t DMA_PERI_MAP_SPI_RX    = 7;
 
 static constexpr uint32_t N_DMA_CHANS            = 15; // ignore the physically separate one
 
+// Largest TXFR_LEN a CB can ask for. Channels 7 and up are DMA Lite, whose
+// length field is only 16 bits wide.
+static constexpr uint32_t DMA_MAX_XFER_LEN       = 0x3FFFFFFF;
+static constexpr uint32_t DMA_LITE_MAX_XFER_LEN  = 0xFFFF;
+
 union DMAControlStatus {
     struct {
         uint32_t active             : 1 = 0;
@@ -71,6 +76,62 @@ union DMATransferInfo {
     uint32_t bits;
 };
 
+// The same fields as DMATransferInfo, as plain values, so a TI word can be
+// built in a constant expression (reading the union's bits is not one).
+struct DMATransferFlags {
+    bool     int_enable         = false;
+    bool     _2d_mode           = false;
+    bool     wait_for_writes    = false;
+    bool     dest_addr_incr     = false;
+    bool     dest_width_128     = false;
+    bool     dest_dma_req       = false;
+    bool     dest_ignore_writes = false;
+    bool     src_addr_incr      = false;
+    bool     src_width_128      = false;
+    bool     src_dma_req        = false;
+    bool     src_ignore_reads   = false;
+    uint32_t burst_len          = 0;
+    uint32_t peri_map           = 0;
+    uint32_t wait_cycles        = 0;
+    bool     no_wide_bursts     = false;
+};
+
+inline constexpr uint32_t dma_ti(const DMATransferFlags& f) {
+    return uint32_t(f.int_enable)              << 0
+         | uint32_t(f._2d_mode)                << 1
+         | uint32_t(f.wait_for_writes)         << 3
+         | uint32_t(f.dest_addr_incr)          << 4
+         | uint32_t(f.dest_width_128)          << 5
+         | uint32_t(f.dest_dma_req)            << 6
+         | uint32_t(f.dest_ignore_writes)      << 7
+         | uint32_t(f.src_addr_incr)           << 8
+         | uint32_t(f.src_width_128)           << 9
+         | uint32_t(f.src_dma_req)             << 10
+         | uint32_t(f.src_ignore_reads)        << 11
+         | (f.burst_len   & 0xf)               << 12
+         | (f.peri_map    & 0x1f)              << 16
+         | (f.wait_cycles & 0x1f)              << 21
+         | uint32_t(f.no_wide_bursts)          << 26;
+}
+
+static constexpr uint32_t DMA_TI_INT_ENABLE = dma_ti({.int_enable=true});
+
+// Read a peripheral's FIFO on its DREQ into incrementing memory.
+inline constexpr uint32_t dma_ti_peri_to_mem(uint32_t peri_map) {
+    return dma_ti({.wait_for_writes=true, .dest_addr_incr=true, .src_dma_req=true, .peri_map=peri_map});
+}
+
+// Write incrementing memory to a peripheral's FIFO on its DREQ.
+inline constexpr uint32_t dma_ti_mem_to_peri(uint32_t peri_map) {
+    return dma_ti({.wait_for_writes=true, .dest_dma_req=true, .src_addr_incr=true, .peri_map=peri_map});
+}
+
+// Wait for a peripheral's DREQ and write one don't-care word to its FIFO,
+// consuming the request. Paces whatever the chain does next.
+inline constexpr uint32_t dma_ti_pace(uint32_t peri_map) {
+    return dma_ti({.wait_for_writes=true, .dest_dma_req=true, .src_ignore_reads=true, .peri_map=peri_map});
+}
+
 struct alignas(32) DMAControlBlock {
     uint32_t ti;
     uint32_t src;
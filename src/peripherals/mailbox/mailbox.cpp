@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <bit>
 #include <iostream>
 #include <stdexcept>
 #include <unistd.h>
@@ -15,12 +17,132 @@ Mailbox::Mailbox() {
 }
 
 Mailbox::~Mailbox() {
+    try {
+        trim_vc_pool();
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Mailbox: " << e.what() << std::endl;
+    }
+
     if (_vcio_fd >= 0) {
         close(_vcio_fd);
     }
 }
 
-MemPtrs Mailbox::alloc_vc_mem(uint32_t size, uint32_t alignment) const {
+// VC memory is mapped as device memory, where memset()'s cache-zeroing
+// instructions fault, so clear it a word at a time.
+static void zero_vc_mem(void* virt, size_t n_bytes) {
+    auto* words = static_cast<volatile uint64_t*>(virt);
+    for (size_t i = 0; i < (n_bytes + 7) / 8; ++i) {
+        words[i] = 0;
+    }
+}
+
+uint32_t Mailbox::_vc_size_class(uint32_t size) const {
+    const uint32_t page = _asi.page_size;
+    size = std::max<uint32_t>(1, (size + page - 1) / page) * page;
+    if (size <= 8 * page) {
+        return size;
+    }
+    const uint32_t step = std::bit_floor(size) / 8;
+    return (size + step - 1) / step * step;
+}
+
+MemPtrs Mailbox::alloc_vc_mem(uint32_t size, uint32_t alignment) {
+    const uint32_t block_size = _vc_size_class(size);
+
+    std::lock_guard<std::mutex> lock(_pool_mutex);
+    ++_vc_stats.requests;
+
+    auto best = _vc_idle.end();
+    for (auto it = _vc_idle.begin(); it != _vc_idle.end(); ++it) {
+        const bool fits = it->size >= block_size && ((uintptr_t)it->mem.bus % alignment) == 0;
+        if (fits && (best == _vc_idle.end() || it->size < best->size)) {
+            best = it;
+        }
+    }
+
+    VCBlock block;
+    if (best != _vc_idle.end()) {
+        block = *best;
+        _vc_idle.erase(best);
+        --_vc_stats.blocks_idle;
+        _vc_stats.bytes_idle -= block.size;
+        ++_vc_stats.reused;
+        zero_vc_mem(block.mem.virt, size);
+    } else {
+        try {
+            block = _alloc_vc_block(block_size, alignment);
+        } catch (const std::runtime_error&) {
+            // Idle blocks may be what is in the way.
+            if (_vc_idle.empty()) throw;
+            _trim_vc_pool_locked();
+            block = _alloc_vc_block(block_size, alignment);
+        }
+    }
+
+    _vc_in_use[block.mem.vc_handle] = block;
+    ++_vc_stats.blocks_in_use;
+    _vc_stats.bytes_in_use += block.size;
+    return block.mem;
+}
+
+void Mailbox::free_vc_mem(MemPtrs mem) {
+    if (mem.vc_handle == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_pool_mutex);
+    const auto it = _vc_in_use.find(mem.vc_handle);
+    if (it == _vc_in_use.end()) {
+        // Not from this pool, so its mapping's size is unknown; just give it
+        // back to the VideoCore.
+        _release_vc_block(VCBlock{.mem=mem, .size=0});
+        return;
+    }
+
+    const VCBlock block = it->second;
+    _vc_in_use.erase(it);
+    --_vc_stats.blocks_in_use;
+    _vc_stats.bytes_in_use -= block.size;
+
+    if (_vc_pooling) {
+        _vc_idle.push_back(block);
+        ++_vc_stats.blocks_idle;
+        _vc_stats.bytes_idle += block.size;
+    } else {
+        _release_vc_block(block);
+    }
+}
+
+void Mailbox::trim_vc_pool() {
+    std::lock_guard<std::mutex> lock(_pool_mutex);
+    _trim_vc_pool_locked();
+}
+
+void Mailbox::set_vc_pooling(bool enable) {
+    std::lock_guard<std::mutex> lock(_pool_mutex);
+    _vc_pooling = enable;
+    if (!enable) _trim_vc_pool_locked();
+}
+
+VCPoolStats Mailbox::vc_pool_stats() const {
+    std::lock_guard<std::mutex> lock(_pool_mutex);
+    return _vc_stats;
+}
+
+void Mailbox::_trim_vc_pool_locked() {
+    while (!_vc_idle.empty()) {
+        const VCBlock block = _vc_idle.back();
+        _vc_idle.pop_back();
+        --_vc_stats.blocks_idle;
+        _vc_stats.bytes_idle -= block.size;
+        _release_vc_block(block);
+    }
+}
+
+Mailbox::VCBlock Mailbox::_alloc_vc_block(uint32_t size, uint32_t alignment) {
+    // Allocate and lock can't share a message: the lock needs the handle the
+    // allocation returns.
     auto alloc_msg = MboxMessage<AllocMemPtrs>{
         .tags = {
             AllocMemPtrs {
@@ -48,28 +170,39 @@ MemPtrs Mailbox::alloc_vc_mem(uint32_t size, uint32_t alignment) const {
     auto phys_addr = _asi.bus_to_phys(bus_addr);
     auto virt_addr = map_phys_block(phys_addr, size, _asi.page_size);
 
-    return MemPtrs {
-        .virt=virt_addr,
-        .phys=phys_addr,
-        .bus=bus_addr,
-        .vc_handle=vc_mem_handle
+    ++_vc_stats.vc_allocs;
+    _vc_stats.peak_bytes = std::max(
+        _vc_stats.peak_bytes, _vc_stats.bytes_in_use + _vc_stats.bytes_idle + size
+    );
+
+    return VCBlock {
+        .mem = MemPtrs {
+            .virt=virt_addr,
+            .phys=phys_addr,
+            .bus=bus_addr,
+            .vc_handle=vc_mem_handle
+        },
+        .size = size
     };
 }
 
-void Mailbox::free_vc_mem(MemPtrs mem) const {
-    if (mem.vc_handle == 0) {
-        return;
+void Mailbox::_release_vc_block(const VCBlock& block) {
+    if (block.size) {
+        unmap_phys_block(block.mem.virt, block.size, _asi.page_size);
     }
 
-    auto unlock_msg = MboxMessage<UnlockMemPtrs>{.tags={UnlockMemPtrs{.req_handle=mem.vc_handle}}};
-    xfer(unlock_msg);
-    if (std::get<0>(unlock_msg.tags).resp_status != 0) {
+    // Unlock and release in one round trip.
+    const uint32_t handle = block.mem.vc_handle;
+    auto msg = MboxMessage<UnlockMemPtrs, ReleaseMemPtrs>{
+        .tags={UnlockMemPtrs{.req_handle=handle}, ReleaseMemPtrs{.req_handle=handle}}
+    };
+    xfer(msg);
+    ++_vc_stats.vc_releases;
+
+    if (std::get<0>(msg.tags).resp_status != 0) {
         throw std::runtime_error("Failed to unlock VC memory.");
     }
-
-    auto release_msg = MboxMessage<ReleaseMemPtrs>{.tags={ReleaseMemPtrs{.req_handle=mem.vc_handle}}};
-    xfer(release_msg);
-    if (std::get<0>(release_msg.tags).resp_status != 0) {
+    if (std::get<1>(msg.tags).resp_status != 0) {
         throw std::runtime_error("Failed to release VC memory.");
     }
 }
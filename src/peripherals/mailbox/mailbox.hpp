@@ -2,7 +2,10 @@
 
 // <3 https://bitbanged.com/posts/understanding-rpi/the-mailbox/ <3
 
+#include <mutex>
 #include <stdexcept>
+#include <unordered_map>
+#include <vector>
 #include <sys/ioctl.h>
 
 #include "utils/reg_mem_utils.hpp"
@@ -75,6 +78,18 @@ struct alignas(16) MboxMessage {
     const uint32_t end_tag = 0;
 };
 
+struct VCPoolStats {
+    uint64_t requests      = 0;  // alloc_vc_mem() calls
+    uint64_t reused        = 0;  // ... served from an idle pooled block
+    uint64_t vc_allocs     = 0;  // fresh allocate + lock + map round trips
+    uint64_t vc_releases   = 0;  // unmap + unlock + release round trips
+    size_t   blocks_in_use = 0;
+    size_t   bytes_in_use  = 0;  // block sizes, which can exceed the requests
+    size_t   blocks_idle   = 0;
+    size_t   bytes_idle    = 0;
+    size_t   peak_bytes    = 0;  // most ever held, in use plus idle
+};
+
 class Mailbox {
     public:
         Mailbox();
@@ -83,8 +98,20 @@ class Mailbox {
         template <typename... TagType>
         void xfer(MboxMessage<TagType...>& msg, uint32_t channel=8) const;
 
-        MemPtrs alloc_vc_mem(uint32_t size, uint32_t alignment=4096) const;
-        void free_vc_mem(MemPtrs mem) const;
+        // VC memory comes from a pool. free_vc_mem() keeps the block, still
+        // locked and mapped, and alloc_vc_mem() hands back the smallest idle
+        // block that fits before asking the VideoCore for a new one, so a
+        // resize that frees then allocates reuses the old block when it is big
+        // enough. Blocks come zeroed either way. Idle blocks are released by
+        // trim_vc_pool(), when a fresh allocation fails, and on destruction.
+        MemPtrs alloc_vc_mem(uint32_t size, uint32_t alignment=4096);
+        void free_vc_mem(MemPtrs mem);
+        void trim_vc_pool();
+
+        // With pooling off, free_vc_mem() releases blocks right away.
+        void set_vc_pooling(bool enable);
+        bool vc_pooling() const { return _vc_pooling; }
+        VCPoolStats vc_pool_stats() const;
 
     protected:
         template <typename... TagType>
@@ -92,6 +119,24 @@ class Mailbox {
 
         int _vcio_fd = -1;
         AddressSpaceInfo _asi;
+
+        struct VCBlock {
+            MemPtrs  mem;
+            uint32_t size;
+        };
+
+        mutable std::mutex _pool_mutex;
+        bool _vc_pooling = true;
+        std::vector<VCBlock> _vc_idle;
+        std::unordered_map<uint32_t, VCBlock> _vc_in_use;  // by VC handle
+        VCPoolStats _vc_stats;
+
+        // Round up to whole pages, then to one of eight sizes per power of
+        // two, so freed blocks fit nearby requests.
+        uint32_t _vc_size_class(uint32_t size) const;
+        VCBlock _alloc_vc_block(uint32_t size, uint32_t alignment);
+        void _release_vc_block(const VCBlock& block);
+        void _trim_vc_pool_locked();
 };
 
 template <typename... TagType>
@@ -26,7 +26,7 @@ PWM::~PWM() {
     }
 }
 
-void PWM::setup_clock(float duty_cycle, float freq, ClockSource clk_src) {
+float PWM::setup_clock(float duty_cycle, float freq, ClockSource clk_src) {
     _duty_cycle = duty_cycle;
     _freq = freq;
 
@@ -48,12 +48,15 @@ void PWM::setup_clock(float duty_cycle, float freq, ClockSource clk_src) {
     write_reg_with_sleep(_sta_reg, ~0);
 
     if (_use_m_s) {
+        const uint32_t range = (uint32_t)(real_clk_freq / freq);
         write_reg_with_sleep(_dat_reg, (uint32_t)(duty_cycle * real_clk_freq / freq));
-        write_reg_with_sleep(_rng_reg, (uint32_t)(real_clk_freq / freq));
+        write_reg_with_sleep(_rng_reg, range);
+        return real_clk_freq / range;
     } else {
         // TODO
         write_reg_with_sleep(_dat_reg, 1);
         write_reg_with_sleep(_rng_reg, 2);
+        return real_clk_freq / 2;
     }
 }
 
@@ -16,7 +16,8 @@ class PWM : public Peripheral {
         PWM(bool use_fifo=false);
         virtual ~PWM();
 
-        void setup_clock(float duty_cycle, float freq, ClockSource clk_src);
+        // Returns the period rate the clock and range actually give.
+        float setup_clock(float duty_cycle, float freq, ClockSource clk_src);
         void start();
         void stop();
 
@@ -8,6 +8,11 @@
 static constexpr uint32_t SMI_BASE_OFS  = 0x00600000;
 static constexpr uint32_t SMI_LEN  = 0x100;
 
+// Maximum bytes per DMA CB reading SMI data (must fit in a Lite channel's
+// 16-bit len field, and must be an even number so 8-bit packed pairs stay
+// aligned).
+static constexpr uint32_t SMI_DMA_MAX_CB_BYTES = 65534;
+
 static constexpr uint32_t SMI_CS_OFS           = 0x00;
 static constexpr uint32_t SMI_LEN_OFS          = 0x04;
 static constexpr uint32_t SMI_ADDR_OFS         = 0x08;
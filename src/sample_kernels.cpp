@@ -0,0 +1,449 @@
+#include <algorithm>
+#include <bit>
+
+#include "sample_kernels.hpp"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace sample_kernels {
+
+float u8_to_float(uint8_t raw_sample, SampleFormat fmt, std::pair<float, float> vref) {
+    if (fmt == SampleFormat::OFFSET_BINARY) {
+        return unsigned_to_float(raw_sample, 8, vref);
+    }
+
+    const float sample_0_1 = 0.5f + 0.5f * (float)std::bit_cast<int8_t>(raw_sample) / 128.f;
+    return vref.first + (vref.second - vref.first) * sample_0_1;
+}
+
+float unsigned_to_float(uint32_t raw_sample, int n_bits, std::pair<float, float> vref) {
+    const float sample_0_1 = (float)raw_sample / (float)((1u << n_bits) - 1);
+    return vref.first + (vref.second - vref.first) * sample_0_1;
+}
+
+// ---- Scalar reference --------------------------------------------------------
+
+namespace ref {
+
+void unpack_packed_u8(const uint16_t* src, int n_samples, uint16_t* dst) {
+    for (int i = 0; i < (n_samples + 1) / 2; ++i) {
+        dst[2*i+0] = (src[i] >> 8) & 0xff;
+        if ((2*i+1) < n_samples) {
+            dst[2*i+1] = (src[i] >> 0) & 0xff;
+        }
+    }
+}
+
+void copy_words(const uint16_t* src, int n_samples, uint16_t* dst) {
+    for (int i = 0; i < n_samples; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+void unpack_spi_u10(const uint8_t* src, int n_samples, uint16_t* dst) {
+    for (int i = 0; i < n_samples; ++i) {
+        dst[i] = (
+            ((uint32_t)src[2 * i + 0] << 4) |
+            ((uint32_t)src[2 * i + 1] >> 4)
+        ) & 0x3ff;
+    }
+}
+
+void extract_gpio_field(
+    const uint32_t* src, int n_samples, int shift, uint32_t mask, uint16_t* dst
+) {
+    for (int i = 0; i < n_samples; ++i) {
+        dst[i] = (src[i] >> shift) & mask;
+    }
+}
+
+void decode_field(
+    const uint16_t* words, int n_samples, int shift, uint32_t mask,
+    const float* table, float* dst
+) {
+    for (int i = 0; i < n_samples; ++i) {
+        dst[i] = table[(words[i] >> shift) & mask];
+    }
+}
+
+void minmax_f32(const float* src, int n_samples, float* min_out, float* max_out) {
+    float lo = src[0];
+    float hi = src[0];
+    for (int i = 1; i < n_samples; ++i) {
+        lo = std::min(lo, src[i]);
+        hi = std::max(hi, src[i]);
+    }
+    *min_out = lo;
+    *max_out = hi;
+}
+
+void minmax_sum_f32(
+    const float* src, int n_samples, float* min_out, float* max_out, float* sum_out
+) {
+    float lo = src[0];
+    float hi = src[0];
+    float sum = 0.0f;
+    for (int i = 0; i < n_samples; ++i) {
+        lo = std::min(lo, src[i]);
+        hi = std::max(hi, src[i]);
+        sum += src[i];
+    }
+    *min_out = lo;
+    *max_out = hi;
+    *sum_out = sum;
+}
+
+int find_edge(
+    const float* src, int n_samples, float low, float high, bool rising,
+    int index_base, int* armed_at
+) {
+    for (int i = 0; i < n_samples; ++i) {
+        const float v = src[i];
+        const bool arm  = rising ? (v < low) : (v > high);
+        const bool fire = rising ? (v >= high) : (v <= low);
+        if (arm) *armed_at = index_base + i;
+        if (fire && *armed_at >= 0) return index_base + i;
+    }
+    return -1;
+}
+
+}  // namespace ref
+
+// ---- Kernels -----------------------------------------------------------------
+
+void unpack_packed_u8(const uint16_t* src, int n_samples, uint16_t* dst) {
+    int i = 0;
+
+#if defined(__aarch64__)
+    for (; i + 16 <= n_samples; i += 16) {
+        // Swap each byte pair so the bytes come out in sample order.
+        const uint8x16_t raw = vrev16q_u8(vreinterpretq_u8_u16(vld1q_u16(src + i / 2)));
+        vst1q_u16(dst + i + 0, vmovl_u8(vget_low_u8(raw)));
+        vst1q_u16(dst + i + 8, vmovl_u8(vget_high_u8(raw)));
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n_samples; i += 16) {
+        __m128i raw = _mm_loadu_si128((const __m128i*)(src + i / 2));
+        raw = _mm_or_si128(_mm_slli_epi16(raw, 8), _mm_srli_epi16(raw, 8));
+        _mm_storeu_si128((__m128i*)(dst + i + 0), _mm_unpacklo_epi8(raw, zero));
+        _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpackhi_epi8(raw, zero));
+    }
+#endif
+
+    // Tail (and the whole buffer on targets without SIMD).
+    for (; i < n_samples; ++i) {
+        dst[i] = (src[i / 2] >> ((i % 2 == 0) ? 8 : 0)) & 0xff;
+    }
+}
+
+void copy_words(const uint16_t* src, int n_samples, uint16_t* dst) {
+    int i = 0;
+
+#if defined(__aarch64__)
+    for (; i + 8 <= n_samples; i += 8) {
+        vst1q_u16(dst + i, vld1q_u16(src + i));
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= n_samples; i += 8) {
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_loadu_si128((const __m128i*)(src + i)));
+    }
+#endif
+
+    for (; i < n_samples; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+void unpack_spi_u10(const uint8_t* src, int n_samples, uint16_t* dst) {
+    int i = 0;
+
+#if defined(__aarch64__)
+    const uint16x8_t mask = vdupq_n_u16(0x3ff);
+    for (; i + 8 <= n_samples; i += 8) {
+        // Each sample is a big-endian 16-bit frame; swap to host order first.
+        const uint16x8_t frames = vreinterpretq_u16_u8(vrev16q_u8(vld1q_u8(src + 2 * i)));
+        vst1q_u16(dst + i, vandq_u16(vshrq_n_u16(frames, 4), mask));
+    }
+#elif defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi16(0x3ff);
+    for (; i + 8 <= n_samples; i += 8) {
+        __m128i frames = _mm_loadu_si128((const __m128i*)(src + 2 * i));
+        frames = _mm_or_si128(_mm_slli_epi16(frames, 8), _mm_srli_epi16(frames, 8));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_and_si128(_mm_srli_epi16(frames, 4), mask));
+    }
+#endif
+
+    for (; i < n_samples; ++i) {
+        dst[i] = (
+            ((uint32_t)src[2 * i + 0] << 4) |
+            ((uint32_t)src[2 * i + 1] >> 4)
+        ) & 0x3ff;
+    }
+}
+
+void extract_gpio_field(
+    const uint32_t* src, int n_samples, int shift, uint32_t mask, uint16_t* dst
+) {
+    int i = 0;
+
+#if defined(__aarch64__)
+    const int32x4_t neg_shift = vdupq_n_s32(-shift);
+    const uint32x4_t vmask = vdupq_n_u32(mask & 0xffff);
+    for (; i + 8 <= n_samples; i += 8) {
+        const uint32x4_t f0 = vandq_u32(vshlq_u32(vld1q_u32(src + i + 0), neg_shift), vmask);
+        const uint32x4_t f1 = vandq_u32(vshlq_u32(vld1q_u32(src + i + 4), neg_shift), vmask);
+        vst1q_u16(dst + i, vcombine_u16(vmovn_u32(f0), vmovn_u32(f1)));
+    }
+#elif defined(__SSE2__)
+    // SSE2 has no unsigned 32->16 pack, so bias into signed range and back.
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    const __m128i vmask = _mm_set1_epi32(mask & 0xffff);
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(-0x8000);
+    for (; i + 8 <= n_samples; i += 8) {
+        const __m128i f0 = _mm_and_si128(
+            _mm_srl_epi32(_mm_loadu_si128((const __m128i*)(src + i + 0)), count), vmask
+        );
+        const __m128i f1 = _mm_and_si128(
+            _mm_srl_epi32(_mm_loadu_si128((const __m128i*)(src + i + 4)), count), vmask
+        );
+        const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(f0, bias32), _mm_sub_epi32(f1, bias32));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_sub_epi16(packed, bias16));
+    }
+#endif
+
+    for (; i < n_samples; ++i) {
+        dst[i] = (src[i] >> shift) & mask;
+    }
+}
+
+void decode_field(
+    const uint16_t* words, int n_samples, int shift, uint32_t mask,
+    const float* table, float* dst
+) {
+    int i = 0;
+
+    // Extract 8 codes at a time with SIMD, then gather their table entries
+    // with scalar loads from a table that lives in L1.
+#if defined(__aarch64__)
+    alignas(16) uint16_t codes[8];
+    const int16x8_t neg_shift = vdupq_n_s16(-shift);
+    const uint16x8_t vmask = vdupq_n_u16(mask);
+    for (; i + 8 <= n_samples; i += 8) {
+        vst1q_u16(codes, vandq_u16(vshlq_u16(vld1q_u16(words + i), neg_shift), vmask));
+        for (int k = 0; k < 8; ++k) {
+            dst[i + k] = table[codes[k]];
+        }
+    }
+#elif defined(__SSE2__)
+    alignas(16) uint16_t codes[8];
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    const __m128i vmask = _mm_set1_epi16(mask);
+    for (; i + 8 <= n_samples; i += 8) {
+        const __m128i w = _mm_loadu_si128((const __m128i*)(words + i));
+        _mm_store_si128((__m128i*)codes, _mm_and_si128(_mm_srl_epi16(w, count), vmask));
+        for (int k = 0; k < 8; ++k) {
+            dst[i + k] = table[codes[k]];
+        }
+    }
+#endif
+
+    for (; i < n_samples; ++i) {
+        dst[i] = table[(words[i] >> shift) & mask];
+    }
+}
+
+void minmax_f32(const float* src, int n_samples, float* min_out, float* max_out) {
+    float lo = src[0];
+    float hi = src[0];
+    int i = 0;
+
+#if defined(__aarch64__)
+    if (n_samples >= 4) {
+        float32x4_t vlo = vld1q_f32(src);
+        float32x4_t vhi = vlo;
+        for (i = 4; i + 4 <= n_samples; i += 4) {
+            const float32x4_t v = vld1q_f32(src + i);
+            vlo = vminq_f32(vlo, v);
+            vhi = vmaxq_f32(vhi, v);
+        }
+        lo = vminvq_f32(vlo);
+        hi = vmaxvq_f32(vhi);
+    }
+#elif defined(__SSE2__)
+    if (n_samples >= 4) {
+        __m128 vlo = _mm_loadu_ps(src);
+        __m128 vhi = vlo;
+        for (i = 4; i + 4 <= n_samples; i += 4) {
+            const __m128 v = _mm_loadu_ps(src + i);
+            vlo = _mm_min_ps(vlo, v);
+            vhi = _mm_max_ps(vhi, v);
+        }
+        alignas(16) float lanes_lo[4], lanes_hi[4];
+        _mm_store_ps(lanes_lo, vlo);
+        _mm_store_ps(lanes_hi, vhi);
+        lo = std::min(std::min(lanes_lo[0], lanes_lo[1]), std::min(lanes_lo[2], lanes_lo[3]));
+        hi = std::max(std::max(lanes_hi[0], lanes_hi[1]), std::max(lanes_hi[2], lanes_hi[3]));
+    }
+#endif
+
+    for (; i < n_samples; ++i) {
+        lo = std::min(lo, src[i]);
+        hi = std::max(hi, src[i]);
+    }
+    *min_out = lo;
+    *max_out = hi;
+}
+
+void minmax_sum_f32(
+    const float* src, int n_samples, float* min_out, float* max_out, float* sum_out
+) {
+    float lo = src[0];
+    float hi = src[0];
+    float sum = 0.0f;
+    int i = 0;
+
+#if defined(__aarch64__)
+    if (n_samples >= 4) {
+        float32x4_t vlo = vld1q_f32(src);
+        float32x4_t vhi = vlo;
+        float32x4_t vsum = vlo;
+        for (i = 4; i + 4 <= n_samples; i += 4) {
+            const float32x4_t v = vld1q_f32(src + i);
+            vlo  = vminq_f32(vlo, v);
+            vhi  = vmaxq_f32(vhi, v);
+            vsum = vaddq_f32(vsum, v);
+        }
+        lo  = vminvq_f32(vlo);
+        hi  = vmaxvq_f32(vhi);
+        sum = vaddvq_f32(vsum);
+    }
+#elif defined(__SSE2__)
+    if (n_samples >= 4) {
+        __m128 vlo = _mm_loadu_ps(src);
+        __m128 vhi = vlo;
+        __m128 vsum = vlo;
+        for (i = 4; i + 4 <= n_samples; i += 4) {
+            const __m128 v = _mm_loadu_ps(src + i);
+            vlo  = _mm_min_ps(vlo, v);
+            vhi  = _mm_max_ps(vhi, v);
+            vsum = _mm_add_ps(vsum, v);
+        }
+        alignas(16) float lanes_lo[4], lanes_hi[4], lanes_sum[4];
+        _mm_store_ps(lanes_lo, vlo);
+        _mm_store_ps(lanes_hi, vhi);
+        _mm_store_ps(lanes_sum, vsum);
+        lo  = std::min(std::min(lanes_lo[0], lanes_lo[1]), std::min(lanes_lo[2], lanes_lo[3]));
+        hi  = std::max(std::max(lanes_hi[0], lanes_hi[1]), std::max(lanes_hi[2], lanes_hi[3]));
+        sum = (lanes_sum[0] + lanes_sum[1]) + (lanes_sum[2] + lanes_sum[3]);
+    }
+#endif
+
+    for (; i < n_samples; ++i) {
+        lo = std::min(lo, src[i]);
+        hi = std::max(hi, src[i]);
+        sum += src[i];
+    }
+    *min_out = lo;
+    *max_out = hi;
+    *sum_out = sum;
+}
+
+// Resolve one block given bitmasks of its arming and firing samples (bit k =
+// sample base + k). Returns the firing index or -1, updating *armed_at.
+static inline int resolve_edge_block(uint32_t arm, uint32_t fire, int base, int* armed_at) {
+    if (fire != 0) {
+        // Without an earlier arming sample, only fires at or after the first
+        // arming sample in this block count.
+        if (*armed_at < 0) {
+            fire = (arm != 0) ? (fire & ~((1u << std::countr_zero(arm)) - 1)) : 0;
+        }
+        if (fire != 0) {
+            const int j = std::countr_zero(fire);
+            const uint32_t arm_upto_j = arm & ((2u << j) - 1);
+            if (arm_upto_j != 0) {
+                *armed_at = base + 31 - std::countl_zero(arm_upto_j);
+            }
+            return base + j;
+        }
+    }
+
+    if (arm != 0) {
+        *armed_at = base + 31 - std::countl_zero(arm);
+    }
+    return -1;
+}
+
+int find_edge(
+    const float* src, int n_samples, float low, float high, bool rising,
+    int index_base, int* armed_at
+) {
+    // Written in terms of a rising edge: "below" arms and "above" fires. A
+    // falling edge swaps the comparisons.
+    int i = 0;
+
+#if defined(__aarch64__)
+    const float32x4_t vlow  = vdupq_n_f32(low);
+    const float32x4_t vhigh = vdupq_n_f32(high);
+    const uint32x4_t  bits  = {1, 2, 4, 8};
+    for (; i + 8 <= n_samples; i += 8) {
+        const float32x4_t a = vld1q_f32(src + i + 0);
+        const float32x4_t b = vld1q_f32(src + i + 4);
+        uint32x4_t arm_a, arm_b, fire_a, fire_b;
+        if (rising) {
+            arm_a  = vcltq_f32(a, vlow);  arm_b  = vcltq_f32(b, vlow);
+            fire_a = vcgeq_f32(a, vhigh); fire_b = vcgeq_f32(b, vhigh);
+        } else {
+            arm_a  = vcgtq_f32(a, vhigh); arm_b  = vcgtq_f32(b, vhigh);
+            fire_a = vcleq_f32(a, vlow);  fire_b = vcleq_f32(b, vlow);
+        }
+
+        // Most blocks neither arm nor fire; skip the mask extraction for them.
+        if (vmaxvq_u32(vorrq_u32(vorrq_u32(arm_a, arm_b), vorrq_u32(fire_a, fire_b))) == 0) {
+            continue;
+        }
+
+        const uint32_t arm  = vaddvq_u32(vandq_u32(arm_a, bits))
+                            | (vaddvq_u32(vandq_u32(arm_b, bits)) << 4);
+        const uint32_t fire = vaddvq_u32(vandq_u32(fire_a, bits))
+                            | (vaddvq_u32(vandq_u32(fire_b, bits)) << 4);
+        const int hit = resolve_edge_block(arm, fire, index_base + i, armed_at);
+        if (hit >= 0) return hit;
+    }
+#elif defined(__SSE2__)
+    const __m128 vlow  = _mm_set1_ps(low);
+    const __m128 vhigh = _mm_set1_ps(high);
+    for (; i + 8 <= n_samples; i += 8) {
+        const __m128 a = _mm_loadu_ps(src + i + 0);
+        const __m128 b = _mm_loadu_ps(src + i + 4);
+        uint32_t arm, fire;
+        if (rising) {
+            arm  = _mm_movemask_ps(_mm_cmplt_ps(a, vlow))  | (_mm_movemask_ps(_mm_cmplt_ps(b, vlow))  << 4);
+            fire = _mm_movemask_ps(_mm_cmpge_ps(a, vhigh)) | (_mm_movemask_ps(_mm_cmpge_ps(b, vhigh)) << 4);
+        } else {
+            arm  = _mm_movemask_ps(_mm_cmpgt_ps(a, vhigh)) | (_mm_movemask_ps(_mm_cmpgt_ps(b, vhigh)) << 4);
+            fire = _mm_movemask_ps(_mm_cmple_ps(a, vlow))  | (_mm_movemask_ps(_mm_cmple_ps(b, vlow))  << 4);
+        }
+        if ((arm | fire) == 0) continue;
+
+        const int hit = resolve_edge_block(arm, fire, index_base + i, armed_at);
+        if (hit >= 0) return hit;
+    }
+#endif
+
+    for (; i < n_samples; ++i) {
+        const float v = src[i];
+        const bool arm  = rising ? (v < low) : (v > high);
+        const bool fire = rising ? (v >= high) : (v <= low);
+        if (arm) *armed_at = index_base + i;
+        if (fire && *armed_at >= 0) return index_base + i;
+    }
+    return -1;
+}
+
+}  // namespace sample_kernels
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+
+// Sample-processing kernels shared by the ADC backends. Every kernel has a
+// NEON path (aarch64), an SSE2 path (x86, so they can be checked and
+// benchmarked off-target) and a scalar fallback. The scalar reference
+// versions live in sample_kernels::ref and define the expected output
+// bit-for-bit (sums excepted: lane order changes their rounding).
+//
+// Captures are stored as one 16-bit word per sample holding every channel's
+// raw code (see Capture in adc.hpp). The unpack kernels turn DMA receive
+// memory into those words; decode_field() turns one channel's codes back into
+// volts through the per-ADC conversion table (see ADC::code_table()).
+//
+// DMA receive memory is mapped uncached, so the kernels only ever make
+// naturally aligned loads from src.
+
+// How raw ADC codes are encoded.
+enum class SampleFormat {
+    OFFSET_BINARY = 0,
+    TWOS_COMPLEMENT = 1
+};
+
+namespace sample_kernels {
+
+// Ideal transfer function of an 8-bit ADC, used to fill conversion tables.
+float u8_to_float(uint8_t raw_sample, SampleFormat fmt, std::pair<float, float> vref);
+
+// Ideal transfer function of an n_bits unsigned ADC.
+float unsigned_to_float(uint32_t raw_sample, int n_bits, std::pair<float, float> vref);
+
+// SMI-packed 8-bit samples: two per 16-bit word, byte-swapped by the SMI XRGB
+// packing. Reads (n_samples + 1) / 2 words.
+void unpack_packed_u8(const uint16_t* src, int n_samples, uint16_t* dst);
+
+// Plain copy of 16-bit SMI words (one 8-bit sample per channel per word).
+void copy_words(const uint16_t* src, int n_samples, uint16_t* dst);
+
+// 10-bit SPI samples, big-endian in bits [13:4] of each 2-byte frame.
+void unpack_spi_u10(const uint8_t* src, int n_samples, uint16_t* dst);
+
+// (word >> shift) & mask of 32-bit GPIO level words (LA mode).
+void extract_gpio_field(
+    const uint32_t* src, int n_samples, int shift, uint32_t mask, uint16_t* dst
+);
+
+// dst[i] = table[(words[i] >> shift) & mask]
+void decode_field(
+    const uint16_t* words, int n_samples, int shift, uint32_t mask,
+    const float* table, float* dst
+);
+
+// Minimum and maximum of src[0..n_samples), n_samples >= 1.
+void minmax_f32(const float* src, int n_samples, float* min_out, float* max_out);
+
+// Minimum, maximum and sum of src[0..n_samples) in one pass, n_samples >= 1.
+void minmax_sum_f32(
+    const float* src, int n_samples, float* min_out, float* max_out, float* sum_out
+);
+
+// Trigger edge search. A rising edge is armed by a sample below low and
+// fires on the first sample at or above high at or after it; a falling edge
+// is armed above high and fires at or below low. *armed_at carries the index
+// of the latest arming sample (-1 if none) so a long buffer can be searched
+// in chunks; indices are positions in src plus index_base. Returns the index
+// of the firing sample, with *armed_at set to the last arming sample at or
+// before it, or -1 if the chunk holds no edge.
+int find_edge(
+    const float* src, int n_samples, float low, float high, bool rising,
+    int index_base, int* armed_at
+);
+
+namespace ref {
+
+void unpack_packed_u8(const uint16_t* src, int n_samples, uint16_t* dst);
+void copy_words(const uint16_t* src, int n_samples, uint16_t* dst);
+void unpack_spi_u10(const uint8_t* src, int n_samples, uint16_t* dst);
+void extract_gpio_field(
+    const uint32_t* src, int n_samples, int shift, uint32_t mask, uint16_t* dst
+);
+void decode_field(
+    const uint16_t* words, int n_samples, int shift, uint32_t mask,
+    const float* table, float* dst
+);
+void minmax_f32(const float* src, int n_samples, float* min_out, float* max_out);
+void minmax_sum_f32(
+    const float* src, int n_samples, float* min_out, float* max_out, float* sum_out
+);
+int find_edge(
+    const float* src, int n_samples, float low, float high, bool rising,
+    int index_base, int* armed_at
+);
+
+}  // namespace ref
+
+}  // namespace sample_kernels
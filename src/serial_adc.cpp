@@ -15,6 +15,7 @@
 #include "peripherals/pwm/pwm_defs.hpp"
 #include "peripherals/spi/spi.hpp"
 #include "peripherals/spi/spi_defs.hpp"
+#include "sample_kernels.hpp"
 #include "serial_adc.hpp"
 #include "utils/reg_mem_utils.hpp"
 #include "utils/rpi_zero_2.hpp"
@@ -29,8 +30,10 @@ SerialADC::SerialADC(
     ADC(vref, n_samples, n_channels),
     _spi_flag_bits(spi_flag_bits),
     _rx_block_size(rx_block_size),
+    _rx_dma_chan(DMAChannelRegistry::instance().acquire(_dma)),
     _spi(8000000, {.bits=spi_flag_bits})
 {
+    _rebuild_code_table();
     resize(n_samples);
 
     _gpio.set_mode(SPI0_GPIO_CE0, GPIOMode::ALT_0);
@@ -52,9 +55,10 @@ SerialADC::~SerialADC() {
 }
 
 void SerialADC::resize(int n_samples) {
+    const ScopedTiming timing(_reconfig_time);
     _stop_worker();
 
-    if (_front_bufs.ndim() == 3 && _front_bufs.shape(1) == n_samples) {
+    if (static_cast<int>(_frames.write_slot()->words.size()) == n_samples) {
         _n_samples = n_samples;
         return;
     }
@@ -66,11 +70,33 @@ void SerialADC::resize(int n_samples) {
         return;
     }
 
-    // 3 uint32_t words for TX (control + CS hold + CS toggle) + 2 bytes per sample for RX
-    const int n_locked_bytes = 3 * sizeof(uint32_t) + n_samples * sizeof(uint16_t);
     if (_dma._use_vc_mem && _data.vc_handle) _dma._mbox.free_vc_mem(_data);
     else if (_data.virt) free(_data.virt);
+    _data = {};
 
+    _alloc_buffers();
+    _resize_captures(_n_channels, _n_samples);
+
+    _setup_dma_cbs();
+}
+
+// Maximum samples per SPI transaction (SPI DL field is 16-bit; 2 bytes/sample).
+static constexpr int SPI_MAX_SAMPLES_PER_SEG = 32767;
+
+static int n_spi_segments(int n_samples) {
+    return (n_samples + SPI_MAX_SAMPLES_PER_SEG - 1) / SPI_MAX_SAMPLES_PER_SEG;
+}
+
+// First FIFO write of a DMA-mode transaction: byte count and CS[7:0].
+static uint32_t spi_xfer_ctrl_word(int n_samples) {
+    return (2 * n_samples) << 16 | (SPIControlStatus{{.clk_pha=1, .xfer_active=1}}.bits & 0xff);
+}
+
+void SerialADC::_alloc_buffers() {
+    // TX words (control + CS hold + CS toggle, then a CS/control pair per
+    // segment boundary) + 2 bytes per sample for each of the two RX buffers.
+    _n_tx_words = 3 + 2 * (n_spi_segments(_n_samples) - 1);
+    const int n_locked_bytes = _n_tx_words * sizeof(uint32_t) + 2 * _n_samples * sizeof(uint16_t);
     if (_dma._use_vc_mem) {
         _data = _dma._mbox.alloc_vc_mem(n_locked_bytes, _asi.page_size);
     } else {
@@ -80,115 +106,109 @@ void SerialADC::resize(int n_samples) {
     }
     _tx_data_virt = (uint32_t*)_data.virt;
     _tx_data_bus  = (uint32_t*)_data.bus;
-    _rx_data_virt = (uint8_t*)(_tx_data_virt + 3);
-    _rx_data_bus  = (uint8_t*)(_tx_data_bus  + 3);
-
-    _resize_flat_bufs(_n_channels, _n_samples);
-
-    _setup_dma_cbs();
+    _rx_data_virt = (uint8_t*)(_tx_data_virt + _n_tx_words);
+    _rx_data_bus  = (uint8_t*)(_tx_data_bus  + _n_tx_words);
 }
 
-// Maximum samples per SPI transaction (SPI DL field is 16-bit; 2 bytes/sample).
-static constexpr int SPI_MAX_SAMPLES_PER_SEG = 32767;
-
 void SerialADC::_setup_dma_cbs() {
     // LA mode is handled entirely by _setup_la_dma_cbs() in the base class.
     // This function only handles the SPI path.
 
     // Each SPI transaction is limited to SPI_MAX_SAMPLES_PER_SEG samples by the
-    // 16-bit DL field. Larger captures use multiple sequential transactions; the
-    // CBs here cover one segment.
+    // 16-bit DL field. Larger captures are several back-to-back transactions
+    // in one RX chain: after a segment's RX CBs, a reload CB rewrites the SPI
+    // CS register (ending the transaction and clearing the FIFOs of leftover
+    // TX pacing words) and then the FIFO with the next segment's control
+    // word. CS and FIFO are adjacent registers, so that is a single 8-byte
+    // write the TX channel can't slip a pacing word into. The whole capture
+    // then runs without the CPU; segment boundaries only cost the reload.
+    const int n_segs = n_spi_segments(_n_samples);
     _samples_per_seg = std::min(SPI_MAX_SAMPLES_PER_SEG, _n_samples);
-    const int n_rx_cbs = (2 * _samples_per_seg + _rx_block_size - 1) / _rx_block_size;
 
-    _dma.resize_cbs(2 + n_rx_cbs);
-
-    auto& cb0 = _dma.get_cb(0);
-    auto& cb1 = _dma.get_cb(1);
+    int n_rx_cbs = 0;
+    for (int seg = 0; seg < n_segs; ++seg) {
+        const int seg_samps = std::min(_samples_per_seg, _n_samples - seg * _samples_per_seg);
+        n_rx_cbs += (2 * seg_samps + _rx_block_size - 1) / _rx_block_size;
+    }
+    _n_rx_chain_cbs = n_rx_cbs + (n_segs - 1);
 
+    const auto spi_cs_bus_addr   = (uint32_t)(uintptr_t)_spi.reg_to_bus(SPI_CS_OFS);
     const auto spi_fifo_bus_addr = (uint32_t)(uintptr_t)_spi.reg_to_bus(SPI_FIFO_OFS);
+    const auto tx_data_bus       = (uint32_t)(uintptr_t)_tx_data_bus;
+
+    // TX CBs, then one RX chain per RX buffer.
+    DMAChain chain(DMA_LITE_MAX_XFER_LEN);
+    chain.reserve(2 + 2 * _n_rx_chain_cbs);
 
     // CB0: write SPI control word (byte count + mode bits) and initial CS state.
-    cb0.ti = DMATransferInfo{{.wait_for_writes=1, .dest_dma_req=1, .src_addr_incr=1, .peri_map=DMA_PERI_MAP_SPI_TX}}.bits;
-    cb0.src     = (uint32_t)(uintptr_t)_tx_data_bus;
-    cb0.dst     = spi_fifo_bus_addr;
-    cb0.len     = 4 + 4;
-    cb0.next_cb = (uint32_t)(uintptr_t)_dma.get_cb_bus_ptr(1);
-
-    _tx_data_virt[0] = (
-        (2 * _samples_per_seg) << 16
-        | (SPIControlStatus{{.clk_pha=1, .xfer_active=1}}.bits & 0xff)
-    );
+    static constexpr uint32_t tx_ti = dma_ti_mem_to_peri(DMA_PERI_MAP_SPI_TX);
+    chain.add(tx_ti, tx_data_bus, spi_fifo_bus_addr, 4 + 4);
+
+    _tx_data_virt[0] = spi_xfer_ctrl_word(_samples_per_seg);
     _tx_data_virt[1] = 0b11111111111111111111111111111111;
 
     // CB1: toggle CS in a loop to pace the transfer.
-    cb1.ti = DMATransferInfo{{.wait_for_writes=1, .dest_dma_req=1, .src_addr_incr=0, .peri_map=DMA_PERI_MAP_SPI_TX}}.bits;
-    cb1.src     = (uint32_t)(uintptr_t)(_tx_data_bus + 2);
-    cb1.dst     = spi_fifo_bus_addr;
-    cb1.len     = 4;
-    cb1.next_cb = (uint32_t)(uintptr_t)_dma.get_cb_bus_ptr(1);
+    static constexpr uint32_t tx_loop_ti = dma_ti({
+        .wait_for_writes=true, .dest_dma_req=true, .peri_map=DMA_PERI_MAP_SPI_TX
+    });
+    const int tx_loop = chain.add(tx_loop_ti, tx_data_bus + 2 * 4, spi_fifo_bus_addr, 4);
+    chain.link(tx_loop, tx_loop);
 
     _tx_data_virt[2] = 0b00000001000000000000000100000000;
 
-    // CB2+: chain RX CBs to capture the first segment's bytes.
-    uint8_t* cur_rx_ptr = _rx_data_bus;
-    int rx_bytes_rem = 2 * _samples_per_seg;
-    for (int i = 2; i < 2 + n_rx_cbs; ++i) {
-        auto& cbi  = _dma.get_cb(i);
-        cbi.ti     = DMATransferInfo{{.wait_for_writes=1, .dest_addr_incr=1, .src_dma_req=1, .peri_map=DMA_PERI_MAP_SPI_RX}}.bits;
-        cbi.src    = spi_fifo_bus_addr;
-        cbi.dst    = (uint32_t)(uintptr_t)cur_rx_ptr;
-        cbi.len    = std::min(_rx_block_size, rx_bytes_rem);
-        cbi.next_cb = (i < (n_rx_cbs + 2 - 1))
-            ? (uint32_t)(uintptr_t)_dma.get_cb_bus_ptr(i + 1) : 0;
-
-        cur_rx_ptr   += _rx_block_size;
-        rx_bytes_rem -= _rx_block_size;
+    // Reload pairs: CS as SPI::start_dma() leaves it (TA clear), then the
+    // control word of the segment that follows.
+    const uint32_t cs_reload = _spi_flag_bits
+        | SPIControlStatus{{.clear_tx=1, .clear_rx=1, .dma_enab=1}}.bits;
+    for (int seg = 1; seg < n_segs; ++seg) {
+        const int seg_samps = std::min(_samples_per_seg, _n_samples - seg * _samples_per_seg);
+        _tx_data_virt[3 + 2 * (seg - 1) + 0] = cs_reload;
+        _tx_data_virt[3 + 2 * (seg - 1) + 1] = spi_xfer_ctrl_word(seg_samps);
     }
-}
-
-// Update the TX control word and RX CB destinations for the given segment index,
-// then restart both DMA channels. Called between segments in _finish_fetch().
-void SerialADC::_advance_spi_segment(int seg_idx) {
-    const int offset_samps = seg_idx * _samples_per_seg;
-    const int seg_samps    = std::min(_samples_per_seg, _n_samples - offset_samps);
-    const int n_rx_cbs     = (2 * seg_samps + _rx_block_size - 1) / _rx_block_size;
-
-    // Update SPI byte count for this segment.
-    _tx_data_virt[0] = (
-        (2 * seg_samps) << 16
-        | (SPIControlStatus{{.clk_pha=1, .xfer_active=1}}.bits & 0xff)
-    );
-    // Flush TX word from CPU cache if not using GPU-coherent memory.
     if (!_dma._use_vc_mem) {
-        clean_cache(_data.virt, (uint8_t*)_data.virt + _asi.cache_line_size, _asi.cache_line_size);
+        clean_cache(_tx_data_virt, _tx_data_virt + _n_tx_words, _asi.cache_line_size);
     }
 
-    // Repoint RX CBs to the correct offset in the receive buffer.
-    uint8_t* rx_start_bus = _rx_data_bus + (size_t)offset_samps * 2;
-    int rx_bytes_rem      = 2 * seg_samps;
-    for (int i = 2; i < 2 + n_rx_cbs; ++i) {
-        auto& cbi   = _dma.get_cb(i);
-        cbi.dst     = (uint32_t)(uintptr_t)(rx_start_bus + (size_t)(i - 2) * _rx_block_size);
-        cbi.len     = std::min(_rx_block_size, rx_bytes_rem);
-        cbi.next_cb = (i < (n_rx_cbs + 2 - 1))
-            ? (uint32_t)(uintptr_t)_dma.get_cb_bus_ptr(i + 1) : 0;
-        rx_bytes_rem -= _rx_block_size;
+    // RX CBs read the SPI FIFO on its DREQ. The last one of each chain ends
+    // it, raising the completion interrupt when waiting on one.
+    static constexpr uint32_t rx_ti     = dma_ti_peri_to_mem(DMA_PERI_MAP_SPI_RX);
+    static constexpr uint32_t reload_ti = dma_ti({
+        .wait_for_writes=true, .dest_addr_incr=true, .src_addr_incr=true
+    });
+    for (int buf = 0; buf < 2; ++buf) {
+        auto cur_rx_bus = (uint32_t)(uintptr_t)(_rx_data_bus + (size_t)buf * _n_samples * 2);
+
+        for (int seg = 0; seg < n_segs; ++seg) {
+            if (seg > 0) {
+                chain.add(reload_ti, tx_data_bus + (3 + 2 * (seg - 1)) * 4, spi_cs_bus_addr, 4 + 4);
+            }
+
+            // Fixed-size blocks; only the segment's last one may be short.
+            const int seg_samps = std::min(_samples_per_seg, _n_samples - seg * _samples_per_seg);
+            for (int rx_bytes_rem = 2 * seg_samps; rx_bytes_rem > 0; ) {
+                const int len = std::min(_rx_block_size, rx_bytes_rem);
+                chain.add(rx_ti, spi_fifo_bus_addr, cur_rx_bus, len);
+                cur_rx_bus   += len;
+                rx_bytes_rem -= len;
+            }
+        }
+
+        chain.stop(chain.last());
+        if (_dma_irq_fd >= 0) chain.interrupt(chain.last());
     }
 
-    _spi.start_dma(4, 8, 4, 8);
-    _dma.start(_dma_chan_0, /*first_cb_idx=*/0);
-    _dma.start(_dma_chan_1, /*first_cb_idx=*/2);
+    _dma.load_chain(chain);
 }
 
 uint32_t SerialADC::start_sampling(uint32_t sample_rate_hz) {
-    _sample_rate = sample_rate_hz;
-
     if (_logic_analyzer_mode) {
-        _la_start_sampling(sample_rate_hz);
-        return sample_rate_hz;
+        _sample_rate = _la_setup_sampling(sample_rate_hz);
+        _start_worker(_sample_rate);
+        return _sample_rate;
     }
 
+    _sample_rate = sample_rate_hz;
+
     _spi.set_clock(16 * sample_rate_hz);
     _start_worker(sample_rate_hz);
     return sample_rate_hz;
@@ -198,8 +218,8 @@ void SerialADC::stop_sampling() {
     _stop_worker();
 }
 
-float SerialADC::_sample_to_float(uint32_t raw_sample) const {
-    return _VREF.first + (_VREF.second - _VREF.first) * ((float)raw_sample / 1023.f);
+float SerialADC::_code_to_float(uint32_t code) const {
+    return sample_kernels::unsigned_to_float(code, _code_bits(), _VREF);
 }
 
 void SerialADC::_start_fetch() {
@@ -209,43 +229,38 @@ void SerialADC::_start_fetch() {
     }
 
     _spi.start_dma(4, 8, 4, 8);
-    _dma.start(_dma_chan_0, /*first_cb_idx=*/0);
-    _dma.start(_dma_chan_1, /*first_cb_idx=*/2);
+    _dma.start(_dma_chan.id(), /*first_cb_idx=*/0);
+    _dma.start(_rx_dma_chan.id(), /*first_cb_idx=*/2 + _rx_fill * _n_rx_chain_cbs);
 }
 
-void SerialADC::_finish_fetch(float* target) {
+bool SerialADC::_wait_fetch() {
+    if (_logic_analyzer_mode) return _wait_la_fetch();
+
+    // One chain covers every segment, so there is only the end to wait for.
+    const auto status = _wait_dma(
+        _rx_dma_chan.id(), _fetch_started, static_cast<double>(_n_samples) / _sample_rate
+    );
+
+    _dma.reset(_dma_chan.id());
+    _dma.reset(_rx_dma_chan.id());
+    _spi.stop_dma();
+    if (!status.ok()) return false;
+
+    _rx_ready = _rx_fill;
+    _rx_fill ^= 1;
+    return true;
+}
+
+void SerialADC::_finish_fetch(Capture& target) {
     if (_logic_analyzer_mode) {
         _finish_la_fetch(target);
         return;
     }
 
-    // Collect one or more SPI segments, each up to SPI_MAX_SAMPLES_PER_SEG samples.
-    const int n_segs = (_n_samples + _samples_per_seg - 1) / _samples_per_seg;
-    for (int seg = 0; seg < n_segs; ++seg) {
-        const int seg_samps = std::min(_samples_per_seg, _n_samples - seg * _samples_per_seg);
-        // Break up the wait into chunks to balance sleeping vs. finishing on time.
-        _dma.wait(
-            _dma_chan_1,
-            16,
-            std::max(1000000 * seg_samps / (8 * _sample_rate), 1u)
-        );
-
-        _dma.reset(_dma_chan_0);
-        _dma.reset(_dma_chan_1);
-        _spi.stop_dma();
-
-        if (seg + 1 < n_segs) {
-            _advance_spi_segment(seg + 1);
-        }
-    }
-
-    for (int i = 0; i < _n_samples; ++i) {
-        target[i * 2 + 0] = _sample_to_float(
-            ((uint32_t)_rx_data_virt[2 * i + 0] << 4) |
-            ((uint32_t)_rx_data_virt[2 * i + 1] >> 4)
-        );
-        target[i * 2 + 1] = static_cast<float>(i);
-    }
+    sample_kernels::unpack_spi_u10(
+        _rx_data_virt + (size_t)_rx_ready * _n_samples * 2, _n_samples, target.words.data()
+    );
+    target.channels[0] = {.active=true, .shift=0, .mask=0x3ff};
 }
 
 void SerialADC::_abort_fetch() {
@@ -254,27 +269,14 @@ void SerialADC::_abort_fetch() {
         return;
     }
 
-    _dma.reset(_dma_chan_0);
-    _dma.reset(_dma_chan_1);
+    _dma.reset(_dma_chan.id());
+    _dma.reset(_rx_dma_chan.id());
     _spi.stop_dma();
 }
 
 void SerialADC::_on_la_mode_exit() {
     // Re-allocate SPI buffers if they were freed when LA mode was entered.
-    if (!_data.virt) {
-        const int n_locked_bytes = 3 * sizeof(uint32_t) + _n_samples * sizeof(uint16_t);
-        if (_dma._use_vc_mem) {
-            _data = _dma._mbox.alloc_vc_mem(n_locked_bytes, _asi.page_size);
-        } else {
-            _data.virt = alloc_locked_block(n_locked_bytes, _asi.page_size);
-            _data.phys = virt_to_phys(_data.virt, _asi.page_size);
-            _data.bus  = _asi.phys_to_bus(_data.phys);
-        }
-        _tx_data_virt = (uint32_t*)_data.virt;
-        _tx_data_bus  = (uint32_t*)_data.bus;
-        _rx_data_virt = (uint8_t*)(_tx_data_virt + 3);
-        _rx_data_bus  = (uint8_t*)(_tx_data_bus  + 3);
-    }
-    _resize_flat_bufs(_n_channels, _n_samples);
+    if (!_data.virt) _alloc_buffers();
+    _resize_captures(_n_channels, _n_samples);
     _setup_dma_cbs();
 }
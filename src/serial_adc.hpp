@@ -31,27 +31,35 @@ class SerialADC : public ADC {
         uint32_t _spi_flag_bits;
         uint32_t _sample_rate;
         int _samples_per_seg = 0;  // max samples per SPI transaction (≤ 32767)
+        int _n_tx_words = 3;
+        int _n_rx_chain_cbs = 0;   // CBs in each RX buffer's chain
 
-        void _setup_dma_cbs();
-        void _advance_spi_segment(int seg_idx);
+        // (Re)allocate the TX words and both receive buffers.
+        void _alloc_buffers();
+        void _setup_dma_cbs() override;
         void _on_la_mode_exit() override;
 
         void _start_fetch() override;
-        void _finish_fetch(float* target) override;
+        bool _wait_fetch() override;
+        void _finish_fetch(Capture& target) override;
         void _abort_fetch() override;
         double _get_sample_rate_hz() const override { return _sample_rate; }
 
-        float _sample_to_float(uint32_t raw_sample) const;
+        int _code_bits() const override { return 10; }
+        float _code_to_float(uint32_t code) const override;
 
         MemPtrs   _data;
         int _rx_block_size;
         uint32_t* _tx_data_virt = nullptr;
         uint32_t* _tx_data_bus  = nullptr;
-        uint8_t*  _rx_data_virt = nullptr;
+        uint8_t*  _rx_data_virt = nullptr;  // two buffers of 2 * _n_samples bytes
         uint8_t*  _rx_data_bus  = nullptr;
+        int       _rx_fill  = 0;  // buffer the DMA is writing
+        int       _rx_ready = 0;  // last completed buffer
 
-        const int _dma_chan_0 = 9;
-        const int _dma_chan_1 = 10;
+        // TX paces the transfer on the base class's _dma_chan; RX gets its
+        // own channel.
+        DMAChannel _rx_dma_chan;
         const int _n_channels = 1;
 
         SPI _spi;
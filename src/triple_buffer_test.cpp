@@ -0,0 +1,54 @@
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "utils/triple_buffer.hpp"
+
+// Checks TripleBuffer's slot handling, in particular what its slots hold
+// before the first reset(): ADC's captures are shared_ptrs, which start null.
+
+static int n_failed = 0;
+
+static void check(bool ok, const char* what) {
+    std::cerr << (ok ? "ok      " : "FAILED  ") << what << std::endl;
+    n_failed += ok ? 0 : 1;
+}
+
+struct Frame {
+    std::vector<int> words;
+};
+
+int main() {
+    {
+        TripleBuffer<std::shared_ptr<Frame>> frames;
+        check(frames.write_slot() == nullptr, "a shared_ptr slot is null before reset()");
+        check(frames.read_slot() == nullptr, "so is the read slot");
+
+        frames.reset(std::make_shared<Frame>());
+        check(frames.write_slot() != nullptr, "reset() seeds the write slot");
+        check(frames.write_slot()->words.empty(), "the seeded write slot can be looked at");
+        check(frames.read_slot() != nullptr, "reset() seeds the read slot");
+    }
+
+    {
+        TripleBuffer<int> buf;
+        buf.reset(0);
+        check(!buf.update(), "nothing to update() right after reset()");
+
+        buf.write_slot() = 1;
+        check(!buf.publish(), "the first publish drops nothing");
+        buf.write_slot() = 2;
+        check(buf.publish(), "publishing over an unread value reports the drop");
+
+        check(buf.update() && buf.read_slot() == 2, "update() adopts the newest value");
+        check(!buf.update() && buf.read_slot() == 2, "and keeps it until the next publish");
+
+        buf.write_slot() = 3;
+        buf.publish();
+        buf.reset(7);
+        check(!buf.update() && buf.read_slot() == 7, "reset() forgets an unread publish");
+    }
+
+    std::cerr << (n_failed ? "FAILED" : "passed") << std::endl;
+    return n_failed ? 1 : 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+
+/*
+ * Histogram of durations in power-of-two nanosecond buckets: bucket 0 counts
+ * zeros and bucket b > 0 counts [2^(b-1), 2^b) ns, the last one open-ended.
+ *
+ * One thread records and any thread may read; counters are relaxed atomics,
+ * so a read taken while recording may be off by the samples in flight.
+ */
+class Log2Histogram {
+public:
+    static constexpr int N_BUCKETS = 32;  // the last bucket starts at ~1 s
+
+    void record(uint64_t ns) {
+        _counts[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static int bucket(uint64_t ns) {
+        const int b = std::bit_width(ns);
+        return (b < N_BUCKETS) ? b : N_BUCKETS - 1;
+    }
+
+    // Exclusive upper edge of bucket b in ns.
+    static uint64_t bucket_upper_ns(int b) { return uint64_t(1) << b; }
+
+    uint64_t count(int b) const { return _counts[b].load(std::memory_order_relaxed); }
+
+    uint64_t total() const {
+        uint64_t n = 0;
+        for (const auto& c : _counts) n += c.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    // Upper edge of the bucket holding quantile q (0..1); 0 when empty.
+    uint64_t quantile_ns(double q) const {
+        const uint64_t n = total();
+        if (n == 0) return 0;
+
+        const auto rank = static_cast<uint64_t>(q * static_cast<double>(n - 1));
+        uint64_t seen = 0;
+        for (int b = 0; b < N_BUCKETS; ++b) {
+            seen += count(b);
+            if (seen > rank) return bucket_upper_ns(b);
+        }
+        return bucket_upper_ns(N_BUCKETS - 1);
+    }
+
+    void reset() {
+        for (auto& c : _counts) c.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, N_BUCKETS> _counts{};
+};
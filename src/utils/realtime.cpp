@@ -0,0 +1,111 @@
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "realtime.hpp"
+
+static std::runtime_error refused(const std::string& what, int err) {
+    return std::runtime_error("Failed to " + what + ": " + std::strerror(err));
+}
+
+void apply_realtime(pthread_t thread, const RealtimeSettings& settings) {
+    const int n_cpus = static_cast<int>(sysconf(_SC_NPROCESSORS_CONF));
+    if (settings.cpu >= n_cpus) {
+        throw std::runtime_error("No CPU " + std::to_string(settings.cpu) + ".");
+    }
+    if (settings.fifo_priority < 0 || settings.fifo_priority > sched_get_priority_max(SCHED_FIFO)) {
+        throw std::runtime_error("fifo_priority must be between 0 and " +
+                                 std::to_string(sched_get_priority_max(SCHED_FIFO)) + ".");
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu = 0; cpu < n_cpus; ++cpu) {
+        if (settings.cpu < 0 || cpu == settings.cpu) CPU_SET(cpu, &cpus);
+    }
+    if (const int err = pthread_setaffinity_np(thread, sizeof(cpus), &cpus)) {
+        throw refused("set CPU affinity", err);
+    }
+
+    sched_param param{};
+    param.sched_priority = settings.fifo_priority;
+    const int policy = (settings.fifo_priority > 0) ? SCHED_FIFO : SCHED_OTHER;
+    if (const int err = pthread_setschedparam(thread, policy, &param)) {
+        throw refused("set SCHED_FIFO priority", err);
+    }
+
+    if (settings.lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        throw refused("lock memory", errno);
+    }
+}
+
+void apply_realtime(pthread_t thread, const RealtimeSettings& settings, const RealtimeSettings& fallback) {
+    try {
+        apply_realtime(thread, settings);
+    } catch (const std::runtime_error&) {
+        try { apply_realtime(thread, fallback); } catch (const std::runtime_error&) {}
+        throw;
+    }
+}
+
+RealtimeStatus realtime_status(pthread_t thread) {
+    RealtimeStatus status;
+
+    cpu_set_t cpus;
+    if (pthread_getaffinity_np(thread, sizeof(cpus), &cpus) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &cpus)) status.cpus.push_back(cpu);
+        }
+    }
+
+    int policy = SCHED_OTHER;
+    sched_param param{};
+    if (pthread_getschedparam(thread, &policy, &param) == 0) {
+        status.fifo = (policy == SCHED_FIFO);
+        status.priority = param.sched_priority;
+    }
+
+    // VmLck counts locked memory, which only mlockall() produces here.
+    std::ifstream proc_status("/proc/self/status");
+    for (std::string line; std::getline(proc_status, line);) {
+        if (line.rfind("VmLck:", 0) == 0) {
+            std::istringstream fields(line.substr(6));
+            long kb = 0;
+            fields >> kb;
+            status.memory_locked = (kb > 0);
+        }
+    }
+
+    std::ifstream isolated("/sys/devices/system/cpu/isolated");
+    std::getline(isolated, status.isolated_cpus);
+    return status;
+}
+
+ScopedRealtime::ScopedRealtime(const RealtimeSettings& settings) {
+    const pthread_t self = pthread_self();
+    pthread_getaffinity_np(self, sizeof(_cpus), &_cpus);
+    pthread_getschedparam(self, &_policy, &_param);
+    try {
+        apply_realtime(self, settings);
+    } catch (const std::runtime_error&) {
+        _restore();
+        throw;
+    }
+}
+
+ScopedRealtime::~ScopedRealtime() {
+    _restore();
+}
+
+void ScopedRealtime::_restore() {
+    const pthread_t self = pthread_self();
+    pthread_setschedparam(self, _policy, &_param);
+    pthread_setaffinity_np(self, sizeof(_cpus), &_cpus);
+}
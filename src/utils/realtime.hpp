@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+// Scheduling for a latency-critical thread. cpu and fifo_priority are a
+// complete state, not a change: the defaults put a thread back to normal.
+// The memory lock is process-wide, so it is only ever added, never removed.
+struct RealtimeSettings {
+    int  cpu           = -1;     // only run on this CPU; -1 for any
+    int  fifo_priority = 0;      // SCHED_FIFO priority (1-99); 0 for SCHED_OTHER
+    bool lock_memory   = false;  // mlockall() the whole process
+};
+
+// What a thread actually runs with, read back from the kernel.
+struct RealtimeStatus {
+    std::vector<int> cpus;           // CPUs it may run on
+    bool             fifo = false;   // SCHED_FIFO
+    int              priority = 0;
+    bool             memory_locked = false;
+    std::string      isolated_cpus;  // the kernel's isolcpus list, for reference
+};
+
+// Apply settings to thread. Throws std::runtime_error naming the setting the
+// kernel refused (usually EPERM without root or CAP_SYS_NICE); whatever was
+// applied before that stays applied.
+void apply_realtime(pthread_t thread, const RealtimeSettings& settings);
+
+// Apply settings to thread, and if the kernel refuses any of them put back
+// fallback before rethrowing.
+void apply_realtime(pthread_t thread, const RealtimeSettings& settings, const RealtimeSettings& fallback);
+
+RealtimeStatus realtime_status(pthread_t thread);
+
+// Apply settings to the calling thread for this object's lifetime, then put
+// back the affinity and scheduling it had. A memory lock is process-wide, so
+// it stays.
+class ScopedRealtime {
+public:
+    explicit ScopedRealtime(const RealtimeSettings& settings);
+    ~ScopedRealtime();
+
+    ScopedRealtime(const ScopedRealtime&) = delete;
+    ScopedRealtime& operator=(const ScopedRealtime&) = delete;
+
+private:
+    cpu_set_t   _cpus;
+    int         _policy;
+    sched_param _param;
+
+    void _restore();
+};
@@ -53,3 +53,12 @@ inline uint64_t read_cntvct_el0() {
     asm volatile("mrs %0, cntvct_el0" : "=r"(cntvct_el0));
     return cntvct_el0;
 }
+
+/*
+ * Read the frequency of the virtual counter in Hz.
+*/
+inline uint64_t read_cntfrq_el0() {
+    uintptr_t cntfrq_el0;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(cntfrq_el0));
+    return cntfrq_el0;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Lock-free triple buffer: one writer hands its latest value to one reader
+ * without either ever waiting on the other.
+ *
+ * There are three slots. The writer owns one, the reader owns one, and the
+ * third ("middle") holds the most recently published value. publish() swaps
+ * the writer's slot with the middle one, and update() swaps the reader's slot
+ * with the middle one if something new was published since the last update().
+ * Both are a single atomic exchange, so the writer is wait-free no matter
+ * what the reader is doing. Values published while the reader is not looking
+ * are overwritten: the reader always gets the newest, never a queue.
+ *
+ * Only one thread at a time may act as the writer, and only one as the reader;
+ * callers with several reader threads serialize them among themselves (that
+ * lock is never touched by the writer).
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+
+    // Set all three slots and forget any unread publish. Not thread-safe:
+    // the writer and reader must both be idle.
+    void reset(const T& value) {
+        for (auto& slot : _slots) {
+            slot.value = value;
+        }
+        _write_idx = 0;
+        _read_idx  = 1;
+        _middle.store(2, std::memory_order_relaxed);
+    }
+
+    // ---- Writer ----
+
+    T& write_slot() { return _slots[_write_idx].value; }
+
+    // Make the write slot the newest value. Returns true if the previous
+    // publish was never picked up by the reader (it is now dropped).
+    bool publish() {
+        const uint8_t old = _middle.exchange(_write_idx | FRESH, std::memory_order_acq_rel);
+        _write_idx = old & INDEX_MASK;
+        return (old & FRESH) != 0;
+    }
+
+    // ---- Reader ----
+
+    // Adopt the newest published value, if there is one since the last call.
+    bool update() {
+        if ((_middle.load(std::memory_order_relaxed) & FRESH) == 0) return false;
+
+        const uint8_t old = _middle.exchange(_read_idx, std::memory_order_acq_rel);
+        _read_idx = old & INDEX_MASK;
+        return true;
+    }
+
+    T& read_slot() { return _slots[_read_idx].value; }
+    const T& read_slot() const { return _slots[_read_idx].value; }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH      = 0x4;
+
+    // Slots and the indices each side touches live on separate cache lines,
+    // so the writer filling its slot does not bounce the reader's lines.
+    struct alignas(64) Slot {
+        T value{};
+    };
+
+    std::array<Slot, 3> _slots;
+    alignas(64) uint8_t _write_idx = 0;  // writer-only
+    alignas(64) uint8_t _read_idx  = 1;  // reader-only
+    alignas(64) std::atomic<uint8_t> _middle{2};
+};